@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include "../src/include/hawktui.hpp"
+
+/** @brief Returns the mean wall time of a call in milliseconds.
+ * @param reps Number of timed calls, after one untimed warm up call.
+ * */
+template <typename F>
+double time_ms(int reps, F&& f) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int i{}; i < reps; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / reps;
+}
+
+/** @brief Prints one result line, stdout belongs to ncurses. */
+inline void result(const char* bench, const char* name, double value,
+                   const char* unit) {
+  std::fprintf(stderr, "%-14s %-40s %12.3f %s\n", bench, name, value, unit);
+}
+
+/** @brief Sets the size of the terminal a bench draws into. */
+inline void screen_size(UIContext& ctx, int width, int height) {
+  resizeterm(height, width);
+  ctx.update_dimensions();
+}
@@ -0,0 +1,27 @@
+#include <random>
+#include "bench.hpp"
+
+// random segments around a 200x60 viewport, a third of them off screen
+static void clip(size_t count, int reps) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> x(-100, 300);
+  std::uniform_int_distribution<int> y(-30, 90);
+  SegmentClipper clipper;
+  for (size_t i{}; i < count; i++) {
+    clipper.add(Coords{x(rng), y(rng)}, Coords{x(rng), y(rng)});
+  }
+  double kernel = time_ms(reps, [&] { clipper.clip(200, 60); });
+  double scalar = time_ms(reps, [&] { clipper.clip_scalar(200, 60); });
+  char name[64];
+  std::snprintf(name, sizeof(name), "%zu segments, %s", count,
+                SegmentClipper::simd() ? "AVX2" : "scalar (no AVX2)");
+  result("clip", name, count / kernel / 1e6, "M clips/ms");
+  std::snprintf(name, sizeof(name), "%zu segments, scalar", count);
+  result("clip", name, count / scalar / 1e6, "M clips/ms");
+}
+
+int main() {
+  clip(4096, 2000);
+  clip(1 << 20, 10);
+  return 0;
+}
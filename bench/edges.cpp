@@ -0,0 +1,69 @@
+#include <random>
+#include "bench.hpp"
+
+// random edges over the whole screen, redrawn in full every frame
+static std::vector<std::shared_ptr<UILine>> scatter(UIContext& ctx,
+                                                   int count) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> x(0, ctx.get_width() - 1);
+  std::uniform_int_distribution<int> y(0, ctx.get_height() - 1);
+  std::vector<std::shared_ptr<UILine>> lines;
+  ctx.begin_update();
+  for (int i{}; i < count; i++) {
+    lines.emplace_back(
+        UILine::create(Coords{x(rng), y(rng)}, Coords{x(rng), y(rng)}));
+    ctx.add_child(lines.back());
+  }
+  ctx.commit();
+  return lines;
+}
+
+static void lines(UIContext& ctx, int count) {
+  auto lines = scatter(ctx, count);
+  const DisplayList& list = ctx.display_list();
+  char name[64];
+
+  // each line drawing itself, as before the batched pass
+  double single = time_ms(20, [&] {
+    for (auto& line : lines) {
+      line->damage();
+      line->render();
+    }
+  });
+  double batched = time_ms(20, [&] {
+    ctx.damage_edges();
+    ctx.render(list, &ctx.compositor());
+  });
+  std::snprintf(name, sizeof(name), "%d lines, UILine::render()", count);
+  result("edges", name, single, "ms/frame");
+  std::snprintf(name, sizeof(name), "%d lines, batched pass", count);
+  result("edges", name, batched, "ms/frame");
+  ctx.clear_children();
+}
+
+// any damaged edge redraws the whole canvas, so time a full redraw
+static void braille(UIContext& ctx, int count) {
+  auto lines = scatter(ctx, count);
+  const DisplayList& list = ctx.display_list();
+  ctx.set_edge_style(EdgeStyle::Braille);
+  double canvas = time_ms(50, [&] {
+    lines.front()->damage();
+    ctx.render(list, &ctx.compositor());
+  });
+  char name[64];
+  std::snprintf(name, sizeof(name), "%d lines, Braille canvas", count);
+  result("edges", name, canvas, "ms/frame");
+  ctx.set_edge_style(EdgeStyle::Lines);
+  ctx.render(list, &ctx.compositor());
+  ctx.clear_children();
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  screen_size(*ctx, 80, 24);
+  lines(*ctx, 20000);
+  braille(*ctx, 200);
+  braille(*ctx, 2000);
+  ctx.reset();
+  return 0;
+}
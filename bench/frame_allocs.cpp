@@ -0,0 +1,59 @@
+#include <cstdlib>
+#include <new>
+#include "bench.hpp"
+
+static size_t allocations{};
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+static auto noop = [](Event::MouseData) {};
+
+// steady state frames of connected nodes with the cursor moving around
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  screen_size(*ctx, 200, 60);
+  std::vector<std::shared_ptr<UINode>> nodes;
+  ctx->begin_update();
+  for (int i{}; i < 200; i++) {
+    nodes.emplace_back(ctx->resources().make<UINode>(
+        &ctx->mouse_event, (i * 13) % 190, (i * 7) % 56, "node", noop));
+    ctx->add_child(nodes.back());
+  }
+  for (int i{1}; i < 200; i++) {
+    nodes[i - 1]->connect(nodes[i].get());
+  }
+  ctx->commit();
+
+  constexpr int frames = 100;
+  // one node dragged back and forth, so its edges redraw every frame
+  auto frame = [&](int i) {
+    ctx->hit_test((i * 3) % 200, (i * 5) % 60);
+    nodes[100]->set_pos(90 + i % 8, 30);
+    ctx->batch_render();
+  };
+  for (int i{}; i < frames; i++) {
+    frame(i);
+  }
+  allocations = 0;
+  double ms = time_ms(frames, [&, i = 0]() mutable { frame(i++); });
+  result("frame_allocs", "200 nodes, 199 edges", ms, "ms/frame");
+  result("frame_allocs", "allocations per frame",
+         static_cast<double>(allocations) / (frames + 1), "");
+
+  nodes.clear();
+  ctx.reset();
+  return 0;
+}
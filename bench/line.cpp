@@ -0,0 +1,66 @@
+#include <random>
+#include "bench.hpp"
+
+// the original UILine::render(), stepping along x with a double gradient
+// and formatting every cell
+static void draw_gradient(WINDOW* window, Coords pos1, Coords pos2) {
+  int x_delta = pos2.x - pos1.x;
+  int y_delta = pos2.y - pos1.y;
+  if (y_delta == 0) {
+    mvwhline(window, pos1.y, std::min(pos1.x, pos2.x), '-',
+             std::abs(x_delta) + 1);
+    return;
+  }
+  if (x_delta == 0) {
+    mvwvline(window, std::min(pos1.y, pos2.y), pos1.x, '|',
+             std::abs(y_delta) + 1);
+    return;
+  }
+  double gradient = (double)(y_delta) / (double)(x_delta);
+  int x_dir = x_delta > 0 ? 1 : -1;
+  char quadrant = (x_delta > 0) == (y_delta > 0) ? '\\' : '/';
+  for (int i{pos1.x}; i != pos2.x; i += x_dir) {
+    int y = static_cast<int>(gradient * (i - pos1.x) + pos1.y);
+    mvwprintw(window, y, i, "%c", quadrant);
+  }
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  screen_size(*ctx, 80, 24);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> x(0, 79);
+  std::uniform_int_distribution<int> y(0, 23);
+  std::vector<std::pair<Coords, Coords>> lines(2000);
+  // cells written per frame, the original left gaps in steep lines
+  double cells{};
+  double gradient_cells{};
+  for (auto& [a, b] : lines) {
+    a = Coords{x(rng), y(rng)};
+    b = Coords{x(rng), y(rng)};
+    int dx = std::abs(b.x - a.x);
+    int dy = std::abs(b.y - a.y);
+    cells += std::max(dx, dy) + 1;
+    gradient_cells += dx == 0 || dy == 0 ? std::max(dx, dy) + 1 : dx;
+  }
+
+  double bresenham = time_ms(200, [&] {
+    for (auto& [a, b] : lines) {
+      UILine::draw(stdscr, a, b, false);
+    }
+  });
+  double gradient = time_ms(200, [&] {
+    for (auto& [a, b] : lines) {
+      draw_gradient(stdscr, a, b);
+    }
+  });
+  double per_cell = bresenham * 1e6 / cells;
+  double gradient_per_cell = gradient * 1e6 / gradient_cells;
+  result("line", "2000 lines, Bresenham spans", per_cell, "ns/cell");
+  result("line", "2000 lines, double gradient", gradient_per_cell,
+         "ns/cell");
+  result("line", "speedup per cell", gradient_per_cell / per_cell, "x");
+
+  ctx.reset();
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench.hpp"
+
+static constexpr int primitives = 50000;
+
+static void compare(UIContext& ctx, const char* scene) {
+  const DisplayList& list = ctx.display_list();
+  ctx.batch_render();
+  double listed = time_ms(50, [&] {
+    ctx.compositor().begin_frame();
+    ctx.render(list, &ctx.compositor());
+  });
+  double virtual_calls = time_ms(50, [&] {
+    ctx.compositor().begin_frame();
+    ctx.render(ctx.get_children());
+  });
+  char name[64];
+  std::snprintf(name, sizeof(name), "%s, display list", scene);
+  result("render", name, listed, "ms/frame");
+  std::snprintf(name, sizeof(name), "%s, virtual render()", scene);
+  result("render", name, virtual_calls, "ms/frame");
+  std::snprintf(name, sizeof(name), "%s, speedup", scene);
+  result("render", name, virtual_calls / listed, "x");
+  ctx.clear_children();
+}
+
+// undamaged lines cost a check each, so dispatch is all there is to time
+static void idle_lines(UIContext& ctx) {
+  int w = ctx.get_width();
+  int h = ctx.get_height();
+  ctx.begin_update();
+  for (int i{}; i < primitives; i++) {
+    ctx.add_child(
+        UILine::create(Coords{i % w, 0}, Coords{(i * 7) % w, h - 1}));
+  }
+  ctx.commit();
+  compare(ctx, "50k idle lines");
+}
+
+// boxes and texts in virtual surfaces draw every frame
+static void surfaces(UIContext& ctx) {
+  int w = ctx.get_width();
+  int h = ctx.get_height();
+  const ElementResources& res = ctx.resources();
+  ctx.begin_update();
+  for (int i{}; i < primitives / 2; i++) {
+    ctx.add_child(UIBox::create(i % (w - 6), i % (h - 3), 6, 3, nullptr, res));
+    ctx.add_child(UIText::create(i % (w - 4), i % h, "text", nullptr, res));
+  }
+  ctx.commit();
+  compare(ctx, "50k boxes and texts");
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  screen_size(*ctx, 200, 60);
+  ctx->set_virtual_surfaces(true);
+  idle_lines(*ctx);
+  surfaces(*ctx);
+  ctx.reset();
+  return 0;
+}
@@ -2,32 +2,70 @@
 #include <panel.h>
 #include <unistd.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "log.hpp"
 #ifndef HAWKTUI_H
 #define HAWKTUI_H
 
 class UIContext;
 class AbstractUIElement;
+class Compositor;
+class WindowPool;
 
 typedef struct Coords {
   int x, y;
 } Coords;
 
+typedef struct Bounds {
+  int x, y, width, height;
+} Bounds;
+
+/** @brief Generational handle to a slot in an ElementStore.
+ * @note Handles to freed slots never become valid again.
+ * */
+typedef struct Handle {
+  uint32_t index{UINT32_MAX};
+  uint32_t generation{};
+} Handle;
+
 namespace Type {
 enum class Id { None, Box, Text, Button, Line, Curve, Node };
 
+/** Number of Id values. */
+inline constexpr size_t id_count = static_cast<size_t>(Id::Node) + 1;
+
 enum class Flags : uint8_t {
   None,
   Draggable,
@@ -57,6 +95,251 @@ constexpr Type::Flags& operator|=(Type::Flags& a, Type::Flags b) {
   return a;
 }
 
+/** @brief Size-class pool allocator for UI elements of one context.
+ *
+ * Elements created through ElementResources::make() are allocated from the
+ * arena, along with their sub-elements, compositions, lifetime tokens and
+ * callbacks. Freed blocks go back to per-size free lists, and once no
+ * allocation is live the whole arena is released at once.
+ * @note Not thread safe. Elements created with make_element() and other
+ * long-lived storage use the default memory resource.
+ * */
+class ElementArena : public std::pmr::memory_resource {
+ private:
+  // blocks too large for the pools go straight back upstream when freed
+  std::pmr::unsynchronized_pool_resource _pool{
+      std::pmr::new_delete_resource()};
+  size_t _bytes{};
+  size_t _peak_bytes{};
+  size_t _live{};
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override {
+    return this == &other;
+  }
+
+ public:
+  /** @brief Releases all memory back to the system if no allocation is
+   * live.
+   * @return True if the arena was released.
+   * */
+  bool release();
+
+  /** @brief Returns the number of bytes currently allocated. */
+  size_t bytes() const { return _bytes; }
+
+  /** @brief Returns the highest number of bytes allocated at once since the
+   * last release. */
+  size_t peak_bytes() const { return _peak_bytes; }
+
+  /** @brief Returns the number of live allocations. */
+  size_t live() const { return _live; }
+};
+
+void* ElementArena::do_allocate(size_t bytes, size_t alignment) {
+  void* p = _pool.allocate(bytes, alignment);
+  _bytes += bytes;
+  _peak_bytes = std::max(_peak_bytes, _bytes);
+  _live++;
+  return p;
+}
+
+void ElementArena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  _pool.deallocate(p, bytes, alignment);
+  _bytes -= bytes;
+  _live--;
+}
+
+bool ElementArena::release() {
+  if (_live)
+    return false;
+  _pool.release();
+  _peak_bytes = 0;
+  return true;
+}
+
+/** @brief Allocator handing out memory from an ElementArena.
+ * @note Keeps the arena alive for as long as the allocation exists, so
+ * elements may safely outlive their context.
+ * */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  std::shared_ptr<ElementArena> arena;
+
+  explicit ArenaAllocator(std::shared_ptr<ElementArena> arena)
+      : arena(std::move(arena)) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    arena->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena == other.arena;
+  }
+};
+
+/** @brief Where new elements and everything they allocate come from.
+ *
+ * Passed last to element constructors and create() factories, which hand it
+ * on to the sub-elements they create. Default constructed, elements use the
+ * global heap. See ScreenContext::resources().
+ * */
+struct ElementResources {
+  /** Arena for elements, compositions, lifetime tokens and callbacks, null
+   * for the global heap. */
+  std::shared_ptr<ElementArena> arena;
+  /** Compositor of virtual surfaces. Elements own a window and panel while
+   * it is null or disabled. */
+  std::shared_ptr<Compositor> compositor;
+  /** Pool recycling windows and panels, null to create and delete them
+   * directly. */
+  std::shared_ptr<WindowPool> windows;
+
+  /** @brief Returns the memory resource compositions allocate from. */
+  std::pmr::memory_resource* memory() const {
+    return arena ? arena.get() : std::pmr::get_default_resource();
+  }
+
+  /** @brief Creates an object from these resources.
+   * @note Elements get the resources as their last constructor argument.
+   * Objects allocated from an arena keep it alive, so elements may safely
+   * outlive their context.
+   * */
+  template <typename T, typename... Args>
+  std::shared_ptr<T> make(Args&&... args) const;
+
+  /** @brief Returns a cleared window of the given size and position. */
+  WINDOW* window(int height, int width, int y, int x) const;
+
+  /** @brief Returns a panel for window placed on top of the deck. */
+  PANEL* panel(WINDOW* window) const;
+
+  /** @brief Gives a window back to the pool, or deletes it.
+   * @warning Panels on the window must be released first.
+   * */
+  void release(WINDOW* window) const;
+
+  /** @brief Hides a panel and gives it back to the pool, or deletes it. */
+  void release(PANEL* panel) const;
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> ElementResources::make(Args&&... args) const {
+  if constexpr (std::is_constructible_v<T, Args..., const ElementResources&>) {
+    if (!arena)
+      return std::make_shared<T>(std::forward<Args>(args)..., *this);
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                   std::forward<Args>(args)..., *this);
+  } else {
+    if (!arena)
+      return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                   std::forward<Args>(args)...);
+  }
+}
+
+/** @brief Type erased callable allocated from an element's resources.
+ * @note std::function has no allocator support, so callbacks of elements in
+ * an arena would otherwise live on the global heap. Copies share the
+ * callable.
+ * */
+template <typename... Args>
+class ElementCallback {
+ private:
+  struct Base {
+    virtual ~Base() = default;
+    virtual void call(Args... args) = 0;
+  };
+  template <typename F>
+  struct Impl final : Base {
+    F f;
+    explicit Impl(F f) : f(std::move(f)) {}
+    void call(Args... args) override { f(args...); }
+  };
+  std::shared_ptr<Base> _callable;
+
+ public:
+  ElementCallback() = default;
+
+  template <typename F>
+  ElementCallback(const ElementResources& res, F&& f)
+      : _callable(res.make<Impl<std::decay_t<F>>>(std::forward<F>(f))) {}
+
+  explicit operator bool() const { return _callable != nullptr; }
+
+  void operator()(Args... args) const { _callable->call(args...); }
+};
+
+/** @brief Creates a UI element with the default memory resource.
+ * @note See ElementResources::make() to pool elements of a context.
+ * */
+template <typename T, typename... Args>
+std::shared_ptr<T> make_element(Args&&... args) {
+  return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+/** @brief Child list of a UI element, allocated from its resources.
+ * @note Adding and removing children reports to the scene of the owning
+ * element, so attached hierarchies stay in sync with their context however
+ * they are edited. Reordering reports nothing.
+ * */
+class Composition {
+ public:
+  using value_type = std::shared_ptr<AbstractUIElement>;
+  using Children = std::pmr::vector<value_type>;
+  using iterator = Children::iterator;
+  using const_iterator = Children::const_iterator;
+
+ private:
+  AbstractUIElement* _owner;
+  Children _children;
+
+ public:
+  Composition(AbstractUIElement* owner, std::pmr::memory_resource* memory)
+      : _owner(owner), _children(memory) {}
+  Composition(const Composition&) = delete;
+  Composition& operator=(const Composition&) = delete;
+
+  iterator begin() { return _children.begin(); }
+  iterator end() { return _children.end(); }
+  const_iterator begin() const { return _children.begin(); }
+  const_iterator end() const { return _children.end(); }
+
+  value_type& operator[](size_t i) { return _children[i]; }
+  const value_type& operator[](size_t i) const { return _children[i]; }
+
+  size_t size() const { return _children.size(); }
+  bool empty() const { return _children.empty(); }
+  size_t capacity() const { return _children.capacity(); }
+
+  /** @brief Appends a child, attaching it if the owner is attached. */
+  value_type& emplace_back(value_type child);
+
+  /** @brief Removes a child, detaching it first if the owner is attached. */
+  iterator erase(const_iterator pos);
+
+  /** @brief Removes the children a predicate holds for, detaching them
+   * first if the owner is attached.
+   * @return Number of children removed.
+   * */
+  template <typename F>
+  size_t erase_if(F&& pred);
+
+  /** @brief Removes all children, detaching them first if the owner is
+   * attached. */
+  void clear();
+};
+
 namespace Event {
 enum class Type {
   Click,
@@ -69,6 +352,9 @@ enum class Type {
   Resize,
 };
 
+/** Number of Type values. */
+inline constexpr size_t type_count = static_cast<size_t>(Type::Resize) + 1;
+
 class EventListener {
  public:
   uintptr_t id;
@@ -109,6 +395,13 @@ void Observer::unsub(Type event, EventListener& listener) {
                 [&](EventListener* e) { return e->id == listener.id; });
 }
 
+/** @brief Returns shared ownership of the element a lifetime token belongs
+ * to, see AbstractUIElement::lifetime().
+ * @return The element, or the token while the element is not owned by a
+ * shared_ptr yet. nullptr once the element is being destroyed.
+ * */
+std::shared_ptr<const void> retain(const std::weak_ptr<const void>& owner);
+
 template <typename C>
 class GenericEvent : public EventListener {
  public:
@@ -119,15 +412,59 @@ class GenericEvent : public EventListener {
     std::function<void(C)> func;
     std::uintptr_t id;
     Type type;
+    /** Lifetime of the element the handler is bound to. */
+    std::weak_ptr<const void> owner;
+    bool owned;
+    /** Set when removed during dispatch, dropped once it ends. */
+    bool removed;
   };
+  // outlives the elements, kept off their arena so it can be released
   std::vector<Meta> _calls;
+  /** Nesting depth of update() calls. */
+  int _dispatching{};
+  /** Set if handlers were marked removed during dispatch. */
+  bool _removed{false};
+
+  static bool _expired(const Meta& m) {
+    return m.removed || (m.owned && m.owner.expired());
+  }
 
  public:
   template <typename F>
   auto add(Type event_type, F&& arg);
 
+  /** @brief Adds a handler bound to an element.
+   * @param owner Lifetime token of the element, see
+   * AbstractUIElement::lifetime(). The handler is skipped and dropped once
+   * it expires.
+   * */
+  template <typename F>
+  auto add(Type event_type, F&& arg, std::weak_ptr<const void> owner);
+
   template <typename F>
   void remove(F&& arg);
+
+  /** @brief Drops handlers whose element was destroyed.
+   * @return Number of handlers dropped.
+   * @note Also done when dispatch finds an expired handler and before the
+   * handler list grows. During dispatch handlers are only marked and
+   * dropped once it ends.
+   * */
+  size_t prune();
+
+  /** @brief Returns the number of handlers registered for an event type.
+   * @note Includes expired handlers not pruned yet.
+   * */
+  size_t count(Type event_type) const;
+
+  /** @brief Returns the number of registered handlers. */
+  size_t size() const { return _calls.size(); }
+
+  /** @brief Calls every handler of an event type.
+   * @note Handlers may add and remove handlers. Handlers added during
+   * dispatch are first called on the next event. Elements are kept alive
+   * while their handlers run.
+   * */
   void update(Type event) override;
 };
 
@@ -135,25 +472,92 @@ template <typename C>
 template <typename F>
 auto GenericEvent<C>::add(Event::Type event_type, F&& arg) {
   auto ptr = reinterpret_cast<std::uintptr_t>(static_cast<void*>(&arg));
-  _calls.emplace_back(
-      Meta{.func = std::forward<F>(arg), .id = ptr, .type = event_type});
+  if (_calls.size() == _calls.capacity())
+    prune();
+  _calls.emplace_back(Meta{.func = std::forward<F>(arg),
+                           .id = ptr,
+                           .type = event_type,
+                           .owner = {},
+                           .owned = false,
+                           .removed = false});
+  return ptr;
+}
+
+template <typename C>
+template <typename F>
+auto GenericEvent<C>::add(Event::Type event_type,
+                          F&& arg,
+                          std::weak_ptr<const void> owner) {
+  auto ptr = reinterpret_cast<std::uintptr_t>(static_cast<void*>(&arg));
+  if (_calls.size() == _calls.capacity())
+    prune();
+  _calls.emplace_back(Meta{.func = std::forward<F>(arg),
+                           .id = ptr,
+                           .type = event_type,
+                           .owner = std::move(owner),
+                           .owned = true,
+                           .removed = false});
   return ptr;
 }
 
+template <typename C>
+size_t GenericEvent<C>::prune() {
+  if (!_dispatching)
+    return std::erase_if(_calls, _expired);
+  // indices of the running dispatch stay valid until it ends
+  size_t count{};
+  for (Meta& m : _calls) {
+    if (!m.removed && _expired(m)) {
+      m.removed = true;
+      count++;
+    }
+  }
+  _removed |= count > 0;
+  return count;
+}
+
+template <typename C>
+size_t GenericEvent<C>::count(Type event_type) const {
+  return std::ranges::count(_calls, event_type, &Meta::type);
+}
+
 template <typename C>
 template <typename F>
 void GenericEvent<C>::remove(F&& arg) {
   auto ptr = reinterpret_cast<std::uintptr_t>(static_cast<void*>(&arg));
-  std::erase_if(_calls, [&ptr](Meta m) { return m.id == ptr; });
+  if (!_dispatching) {
+    std::erase_if(_calls, [&ptr](const Meta& m) { return m.id == ptr; });
+    return;
+  }
+  for (Meta& m : _calls) {
+    if (m.id == ptr) {
+      m.removed = true;
+      _removed = true;
+    }
+  }
 }
 
 template <typename C>
 void GenericEvent<C>::update(Type event) {
-  for (Meta& x : _calls) {
-    if (x.type == event) {
-      x.func(this->data);
+  _dispatching++;
+  // by index over the handlers present when dispatch started, handlers may
+  // add more and reallocate the list
+  size_t size = _calls.size();
+  for (size_t i{}; i < size; i++) {
+    if (_calls[i].type != event || _calls[i].removed)
+      continue;
+    std::shared_ptr<const void> owner;
+    if (_calls[i].owned && !(owner = retain(_calls[i].owner))) {
+      _calls[i].removed = true;
+      _removed = true;
+      continue;
     }
+    // a copy, the list may reallocate while the handler runs
+    auto func = _calls[i].func;
+    func(this->data);
   }
+  if (--_dispatching == 0 && std::exchange(_removed, false))
+    std::erase_if(_calls, _expired);
 }
 
 struct MouseData {
@@ -162,6 +566,7 @@ struct MouseData {
   int offset_x{0};
   int offset_y{0};
   std::shared_ptr<AbstractUIElement> selected_element;
+  std::shared_ptr<AbstractUIElement> hovered_element;
   UIContext* ctx;
 };
 
@@ -177,685 +582,4977 @@ class ScreenEvent : public GenericEvent<ScreenData> {};
 
 };  // namespace Event
 
-/** @brief Abstract base for all UI elements with nested composition support.
+/** @brief Lightweight virtual window.
+ * @note Owned by the element that created it and shared with the elements
+ * drawing into it, the same way a WINDOW is shared.
+ * */
+typedef struct Surface {
+  int x, y, width, height;
+  /** Last frame the surface was cleared in its layer. */
+  uint64_t frame{};
+} Surface;
+
+/** @brief Composites virtual surfaces through a shared layer window.
  *
- * Subclasses must implement render() and type().
- * Supports hierarchical UI trees
- * via composition member.
- * Defaults:
- *  empty composition
- *  TypeFlags::None
- *  null window
+ * Surfaces are drawn into one real full screen layer window. Presenting a
+ * surface marks exactly its rectangle of the layer as changed and refreshes
+ * the layer with wnoutrefresh, which copies only changed cells, so each
+ * surface reaches the virtual screen at its place in the render order. Any
+ * number of surface elements costs a single ncurses window and no panels.
+ * @note Owned by ScreenContext and handed to elements through
+ * ElementResources. Elements created from it use surfaces instead of their
+ * own window while virtual surfaces are enabled.
  * */
-class AbstractUIElement {
+class Compositor {
+ private:
+  WINDOW* _layer{nullptr};
+  /** Row read back from the layer while presenting. */
+  std::vector<cchar_t> _row;
+  uint64_t _frame{1};
+  bool _enabled{false};
+
+  WINDOW* layer();
+  void prepare(Surface& surface);
+
  public:
-  AbstractUIElement() = default;
-  virtual ~AbstractUIElement() = default;
+  /** @brief Enables or disables virtual surfaces for new elements. */
+  void set_enabled(bool enabled) { _enabled = enabled; }
+  bool enabled() const { return _enabled; }
 
-  int z_index = 0;
-  std::vector<std::shared_ptr<AbstractUIElement>> composition{};
-  Type::Flags flags{Type::Flags::None};
-  WINDOW* window{nullptr};
-  PANEL* panel;
+  /** @brief Starts a new frame. Surfaces are cleared the first time they are
+   * drawn in a frame. */
+  void begin_frame() { _frame++; }
 
-  /** @brief Calls ncurses functions to draw UI element to its parent
-   * ScreenContext window.
-   * @note Automatically invoked by UIContext::render() during batch rendering.
-   */
-  virtual void render() = 0;
+  /** @brief Draws a border around a surface and presents it. */
+  void draw_box(Surface& surface);
 
-  /**@brief Returns this UI element's TypeId.
-   * @warning TypeId must be registered with TypeId::register() before use.
-   * @note Automatically invoked by UIContext::handle_click() during mouse
-   * events.
+  /** @brief Draws a text run inside a surface and presents it.
+   * @param pos Text position relative to the surface.
    * */
-  virtual Type::Id type() = 0;
-};
+  void draw_text(Surface& surface, Coords pos, std::string_view text);
 
-/** @brief Templated UI element base with shared window support and default
- * type().
- * */
-template <Type::Id T>
-class IUIElement : public AbstractUIElement {
- public:
-  IUIElement() = default;
-  IUIElement(WINDOW* window) {
-    this->window = window;
-    panel = new_panel(this->window);
-  }
-  Type::Id type() { return T; }
-};
+  /** @brief Copies the surface rectangle from the layer into the virtual
+   * screen with wnoutrefresh. */
+  void present(const Surface& surface);
 
-/** @bried UI Line element. */
-class UILine : public IUIElement<Type::Id::Line> {
- private:
-  Coords pos1{}, pos2{};
-  double gradient{};
-  int x_delta{};
-  int y_delta{};
-  int width{};
-  int height{};
-  char x_dir{};
-  char y_dir{};
-  char quadrant{};
-  int calcx_line(int x);
-  void calc_char();
-  void _calculate_line_data();
+  /** @brief Resizes the layer after a terminal resize. */
+  void resize(int width, int height);
 
- public:
-  UILine(const Coords& pos1, const Coords& pos2, WINDOW* window);
+  /** @brief Deletes the layer window. */
+  void release();
 
-  static std::shared_ptr<UILine> create(Coords pos1,
-                                        Coords pos2,
-                                        WINDOW* window);
+  /** @brief Draws a border around a rectangle of a window. */
+  static void outline(WINDOW* window, int x, int y, int width, int height);
 
-  void set_pos(Coords pos1, Coords pos2);
-  void render() override;
-};
+  /** @brief Moves and resizes a surface, damaging the area it uncovers. */
+  static void place(Surface& surface, int x, int y, int width, int height);
 
-void UILine::_calculate_line_data() {
-  x_delta = pos2.x - pos1.x;
-  y_delta = pos2.y - pos1.y;
+  /** @brief Returns the number of real ncurses windows held. */
+  size_t windows() const { return _layer ? 1 : 0; }
+};
 
-  if (x_delta == 0) {
-    gradient = 0;
-  } else {
-    gradient = (double)(y_delta) / (double)(x_delta);
+WINDOW* Compositor::layer() {
+  if (!_layer) {
+    _layer = newwin(0, 0, 0, 0);
+    // a fresh window is fully touched and would cover the screen
+    untouchwin(_layer);
   }
-
-  width = std::abs(x_delta) + 1;
-  height = std::abs(y_delta) + 1;
+  return _layer;
 }
 
-UILine::UILine(const Coords& pos1, const Coords& pos2, WINDOW* window)
-    : pos1(pos1), pos2(pos2) {
-  _calculate_line_data();
-  if (window) {
-    this->window = window;
-    wresize(this->window, height, width);
-  } else {
-    this->window = stdscr;
+void Compositor::prepare(Surface& surface) {
+  if (surface.frame == _frame)
+    return;
+  surface.frame = _frame;
+  for (int row{}; row < surface.height; row++) {
+    mvwhline(layer(), surface.y + row, surface.x, ' ', surface.width);
   }
 }
 
-std::shared_ptr<UILine> UILine::create(Coords pos1,
-                                       Coords pos2,
-                                       WINDOW* window = nullptr) {
-  return std::make_shared<UILine>(pos1, pos2, window);
-};
-
-void UILine::set_pos(Coords pos1, Coords pos2) {
-  werase(window);
-  this->pos1 = pos1;
-  this->pos2 = pos2;
-  _calculate_line_data();
-};
-
-int UILine::calcx_line(int x) {
-  return gradient * (x - pos1.x) + pos1.y;
+void Compositor::outline(WINDOW* window,
+                         int x,
+                         int y,
+                         int width,
+                         int height) {
+  if (width < 2 || height < 2)
+    return;
+  int x1 = x + width - 1;
+  int y1 = y + height - 1;
+  mvwhline(window, y, x + 1, ACS_HLINE, width - 2);
+  mvwhline(window, y1, x + 1, ACS_HLINE, width - 2);
+  mvwvline(window, y + 1, x, ACS_VLINE, height - 2);
+  mvwvline(window, y + 1, x1, ACS_VLINE, height - 2);
+  mvwaddch(window, y, x, ACS_ULCORNER);
+  mvwaddch(window, y, x1, ACS_URCORNER);
+  mvwaddch(window, y1, x, ACS_LLCORNER);
+  mvwaddch(window, y1, x1, ACS_LRCORNER);
 }
 
-void UILine::calc_char() {
-  /*  Quadrant layout
-   *  0,2 = '/'
-   *  1,3 = '\'
-   *
-   *       |
-   *    1  |  0
-   *       |
-   *  -----|------
-   *       |
-   *    2  |  3
-   *       |
-   * */
-
-  Coords norm_p2 = {.x = pos2.x, .y = pos2.y};
-  if (pos1.x != 0) {
-    norm_p2.x = pos2.x - pos1.x;
-  }
-  if (pos1.y != 0) {
-    norm_p2.y = pos2.y - pos1.y;
-  }
-
-  x_dir = norm_p2.x > 0 ? 1 : -1;
-  y_dir = norm_p2.y > 0 ? 1 : -1;
+void Compositor::draw_box(Surface& surface) {
+  prepare(surface);
+  outline(layer(), surface.x, surface.y, surface.width, surface.height);
+  present(surface);
+}
 
-  if (x_dir == 1 && y_dir == 1 || x_dir == -1 && y_dir == -1) {
-    quadrant = '\\';
-  } else if (x_dir == -1 && y_dir == 1 || x_dir == 1 && y_dir == -1) {
-    quadrant = '/';
+void Compositor::draw_text(Surface& surface,
+                           Coords pos,
+                           std::string_view text) {
+  prepare(surface);
+  int room = surface.width - pos.x;
+  if (room > 0 && pos.y >= 0 && pos.y < surface.height) {
+    mvwaddnstr(layer(), surface.y + pos.y, surface.x + pos.x, text.data(),
+               std::min(room, static_cast<int>(text.size())));
   }
+  present(surface);
 }
 
-void UILine::render() {
-  if (y_delta == 0) {
-    int fp = 0;
-    if (pos1.x > pos2.x)
-      fp = pos1.x - pos2.x;
-    mvwhline(window, pos1.y, pos1.x - fp, '-', width);
-    wnoutrefresh(window);
+void Compositor::present(const Surface& surface) {
+  WINDOW* w = layer();
+  int max_y{}, max_x{};
+  getmaxyx(w, max_y, max_x);
+  int x0 = std::max(surface.x, 0);
+  int y0 = std::max(surface.y, 0);
+  int x1 = std::min(surface.x + surface.width, max_x) - 1;
+  int y1 = std::min(surface.y + surface.height, max_y) - 1;
+  if (x0 > x1 || y0 > y1)
     return;
+  // writing the rows back marks just the rectangle as changed, other cells
+  // of the layer belong to surfaces presented elsewhere in the order
+  int n = x1 - x0 + 1;
+  _row.resize(n + 1);
+  for (int y = y0; y <= y1; y++) {
+    mvwin_wchnstr(w, y, x0, _row.data(), n);
+    mvwadd_wchnstr(w, y, x0, _row.data(), n);
   }
-  if (x_delta == 0) {
-    int fp = 0;
-    if (pos1.y > pos2.y)
-      fp = pos1.y - pos2.y;
-    mvwvline(window, pos1.y - fp, pos1.x, '|', height);
-    wnoutrefresh(window);
+  wnoutrefresh(w);
+}
+
+void Compositor::place(Surface& surface,
+                       int x,
+                       int y,
+                       int width,
+                       int height) {
+  if (surface.x == x && surface.y == y && surface.width == width &&
+      surface.height == height)
     return;
-  }
+  // the old area is restored from stdscr, which is copied before surfaces
+  int max_y = getmaxy(stdscr);
+  int y0 = std::max(surface.y, 0);
+  int y1 = std::min(surface.y + surface.height, max_y);
+  if (y0 < y1)
+    touchline(stdscr, y0, y1 - y0);
+  surface.x = x;
+  surface.y = y;
+  surface.width = width;
+  surface.height = height;
+}
 
-  calc_char();
+void Compositor::resize(int width, int height) {
+  if (_layer) {
+    wresize(_layer, height, width);
+    untouchwin(_layer);
+  }
+}
 
-  for (int i{pos1.x}; i != pos2.x; i += x_dir) {
-    mvwprintw(window, calcx_line(i), i, "%c", quadrant);
+void Compositor::release() {
+  if (_layer) {
+    delwin(_layer);
+    _layer = nullptr;
   }
-  wnoutrefresh(window);
 }
 
-/** @brief Primitive box element.
- * default:
- *  width 10 chars
- *  height 10 chars
+/** @brief Recycles ncurses windows and panels of destroyed elements.
+ *
+ * Released windows are kept hidden and handed out again through wresize and
+ * mvwin instead of delwin/newwin, so views that rebuild popups and nodes
+ * every frame stop churning ncurses allocations.
+ * @note Owned by ScreenContext and handed to elements through
+ * ElementResources. Without a pool windows and panels are created and
+ * deleted directly.
  * */
-class UIBox : public IUIElement<Type::Id::Box> {
+class WindowPool {
  private:
-  size_t width{};
-  size_t height{};
-  int x{};
-  int y{};
+  std::vector<WINDOW*> _windows;
+  std::vector<PANEL*> _panels;
+  size_t _created{};
+  size_t _reused{};
+  size_t _live_windows{};
+  size_t _live_panels{};
 
  public:
-  /** @brief Overrides the default window with a user provided window.
-   * @note Allows nested window hierarchies.
-   * */
-  UIBox(WINDOW* window);
-  UIBox(WINDOW* window, int w, int h, int xpos, int ypos);
+  ~WindowPool();
 
-  UIBox();
-  UIBox(int w, int h, int xpos, int ypos);
+  /** Maximum number of free windows and of free panels kept. */
+  size_t capacity{256};
 
-  /** @brief Returns height of the current window. */
-  int get_height() const { return height; }
+  /** @brief Returns a cleared window of the given size and position. */
+  WINDOW* window(int height, int width, int y, int x);
 
-  /** @brief Returns width of the current window. */
-  int get_width() const { return width; }
+  /** @brief Returns a panel for window placed on top of the deck. */
+  PANEL* panel(WINDOW* window);
 
-  /** @brief Returns position of the current window.
-   * @return position Coords (x,y).
+  /** @brief Gives a window back to the pool, or deletes it once the pool is
+   * full.
+   * @warning Panels on the window must be released first.
    * */
-  Coords get_pos() const { return Coords{x, y}; }
+  void release(WINDOW* window);
 
-  /** @brief Sets the dimensions of the window and tells the window to resize.
-   * @param w Width in characters.
-   * @param h Height in characters.
-   */
-  void set_dimensions(int w, int h);
+  /** @brief Hides a panel and gives it back to the pool, or deletes it once
+   * the pool is full. */
+  void release(PANEL* panel);
 
-  /** @brief Sets the position of the window and tells the window to move.
-   * @param x Horizontal position
-   * @param y Vectical position
-   * */
-  void set_pos(int x, int y);
+  /** @brief Deletes all free windows and panels. */
+  void clear();
 
-  /**@brief Creates a UI box element and returns it.
-   * @param x Horizontal position
-   * @param y Vertical position
-   * @param height Height of the box
-   * @param width Width of the box
-   * @note All parameters are in characters.
-   * */
-  static std::shared_ptr<UIBox> create(int x,
-                                       int y,
-                                       int height,
-                                       int width,
-                                       WINDOW* window);
+  size_t free_windows() const { return _windows.size(); }
+  size_t free_panels() const { return _panels.size(); }
 
-  /** @brief Draws a box using ncurses. */
-  void render() override;
-};
+  /** @brief Returns how many windows and panels were created. */
+  size_t created() const { return _created; }
 
-UIBox::UIBox(WINDOW* window) : IUIElement(window) {};
+  /** @brief Returns how many windows and panels were recycled. */
+  size_t reused() const { return _reused; }
 
-UIBox::UIBox(WINDOW* window, int w, int h, int xpos, int ypos)
-    : IUIElement(window), width(w), height(h), x(xpos), y(ypos) {}
+  /** @brief Returns the number of windows from this pool alive, free ones
+   * included. */
+  size_t live_windows() const { return _live_windows; }
 
-UIBox::UIBox() : UIBox(10, 5, 0, 0) {};
+  /** @brief Returns the number of panels from this pool alive, free ones
+   * included. */
+  size_t live_panels() const { return _live_panels; }
+};
 
-UIBox::UIBox(int w, int h, int xpos, int ypos)
-    : width(w), height(h), x(xpos), y(ypos) {
-  window = newwin(height, width, y, x);
-  panel = new_panel(window);
+WindowPool::~WindowPool() {
+  clear();
 }
 
-void UIBox::set_dimensions(int width, int height) {
-  this->width = width;
-  this->height = height;
-  wresize(window, height, width);
-}
-
-void UIBox::set_pos(int x, int y) {
-  this->x = x;
-  this->y = y;
+WINDOW* WindowPool::window(int height, int width, int y, int x) {
+  if (_windows.empty()) {
+    _created++;
+    _live_windows++;
+    return newwin(height, width, y, x);
+  }
+  WINDOW* window = _windows.back();
+  _windows.pop_back();
+  _reused++;
+  // resize first so the move is checked against the new size
+  wresize(window, height > 0 ? height : LINES - y,
+          width > 0 ? width : COLS - x);
   mvwin(window, y, x);
+  werase(window);
+  return window;
 }
 
-std::shared_ptr<UIBox> UIBox::create(int x = 0,
-                                     int y = 0,
-                                     int width = 0,
-                                     int height = 0,
-                                     WINDOW* window = nullptr) {
-  if (window) {
-    return std::make_shared<UIBox>(window, width, height, x, y);
+PANEL* WindowPool::panel(WINDOW* window) {
+  if (_panels.empty()) {
+    _created++;
+    _live_panels++;
+    return new_panel(window);
   }
-  return std::make_shared<UIBox>(width, height, x, y);
+  PANEL* panel = _panels.back();
+  _panels.pop_back();
+  _reused++;
+  replace_panel(panel, window);
+  show_panel(panel);
+  return panel;
 }
 
-void UIBox::render() {
-  box(window, 0, 0);
-  wnoutrefresh(window);
+void WindowPool::release(WINDOW* window) {
+  if (!window || window == stdscr)
+    return;
+  if (_windows.size() >= capacity) {
+    _live_windows--;
+    delwin(window);
+    return;
+  }
+  _windows.push_back(window);
 }
 
-/** @brief UI Text element.
- * @note Text elements have a width, height (both are values for the window)
- * A text position, a window position, and label content.
- * @note Use UIText::create over directly intializing the class.
- * @note UIText::create will automatically generate the appropriate text UI
- * element for a given label.
- * */
-class UIText : public IUIElement<Type::Id::Text> {
- private:
-  std::string label;
-  size_t width;
-  size_t height;
-  int text_x;
-  int text_y;
-  int win_x;
-  int win_y;
+void WindowPool::release(PANEL* panel) {
+  if (!panel)
+    return;
+  if (_panels.size() >= capacity) {
+    _live_panels--;
+    del_panel(panel);
+    return;
+  }
+  hide_panel(panel);
+  _panels.push_back(panel);
+}
 
- public:
-  /**@brief Default constructor*/
-  UIText(int text_x,
-         int text_y,
-         int win_x,
-         int win_y,
-         int width,
-         int height,
-         std::string label,
-         WINDOW* window);
-  /**@brief Returns the x and y position of the text inside the current window.
-   */
-  Coords get_text_pos() const { return {win_x, win_y}; };
+void WindowPool::clear() {
+  // hidden panels are not linked to their window, so order does not matter
+  for (PANEL* panel : _panels) {
+    del_panel(panel);
+  }
+  for (WINDOW* window : _windows) {
+    delwin(window);
+  }
+  _live_panels -= _panels.size();
+  _live_windows -= _windows.size();
+  _panels.clear();
+  _windows.clear();
+}
 
-  /**@brief Returns the x and y position of the current window.*/
-  Coords get_window_pos() const { return {win_x, win_y}; };
+WINDOW* ElementResources::window(int height, int width, int y, int x) const {
+  if (windows)
+    return windows->window(height, width, y, x);
+  return newwin(height, width, y, x);
+}
 
-  /**@brief Returns the height of the window.*/
-  int get_height() const { return height; };
+PANEL* ElementResources::panel(WINDOW* window) const {
+  if (windows)
+    return windows->panel(window);
+  return new_panel(window);
+}
 
-  /**@brief Returns the width of the window.*/
-  int get_width() const { return width; };
+void ElementResources::release(WINDOW* window) const {
+  if (windows) {
+    windows->release(window);
+  } else if (window && window != stdscr) {
+    delwin(window);
+  }
+}
 
-  void set_pos(int x, int y);
+void ElementResources::release(PANEL* panel) const {
+  if (windows) {
+    windows->release(panel);
+  } else if (panel) {
+    del_panel(panel);
+  }
+}
 
-  void set_label(std::string label);
+/** @brief Interface for receiving changes from attached UI elements.
+ * @note Implemented by ScreenContext. Elements are attached to a scene when
+ * they are added to a context hierarchy and detached when removed.
+ * */
+class SceneListener {
+ public:
+  virtual ~SceneListener() = default;
 
-  void set_dimensions(int width, int height);
+  /** @brief Called after an attached element changes position, size or
+   * content. */
+  virtual void element_moved(AbstractUIElement* element) = 0;
 
-  /**@brief Creates an UI text element.
-   * @param x Horizontal position of window.
-   * @param y Vectical position of window.
-   * @param label String that is rendered.
-   * @param window Optional window override.
+  /** @brief Called when an attached element gains a new child element after
+   * it was added to the context. */
+  virtual void element_added(AbstractUIElement* parent,
+                             AbstractUIElement* element) = 0;
+
+  /** @brief Called before a child element is removed from an attached
+   * element. */
+  virtual void element_removed(AbstractUIElement* element) = 0;
+
+  /** @brief Called by renderers drawing a line or curve along another path
+   * than its own geometry, e.g. an orthogonal route.
+   * @param path Polyline drawn, empty once the edge is drawn as itself
+   * again.
    * */
-  static std::shared_ptr<UIText> create(int x,
-                                        int y,
-                                        std::string label,
-                                        WINDOW* window);
+  virtual void edge_drawn(AbstractUIElement* /*edge*/,
+                          std::span<const Coords> /*path*/) {}
+};
 
-  /**@brief Creates an UI text element.
-   * @param x Horizontal position of window.
-   * @param y Vectical position of window.
-   * @param width Width of the window in characters.
-   * @param height Height of the window in characters.
-   * @param label String that is rendered.
-   * @param window Optional window override.
+/** @brief Abstract base for all UI elements with nested composition support.
+ *
+ * Subclasses must implement render() and type().
+ * Supports hierarchical UI trees
+ * via composition member.
+ * Defaults:
+ *  empty composition
+ *  TypeFlags::None
+ *  null window
+ * */
+class AbstractUIElement
+    : public std::enable_shared_from_this<AbstractUIElement> {
+ public:
+  explicit AbstractUIElement(const ElementResources& res = {})
+      : resources(res), composition(this, res.memory()) {}
+  virtual ~AbstractUIElement();
+
+  /** Resources the element was created from, handed on to the elements it
+   * creates. */
+  ElementResources resources;
+  int z_index = 0;
+  Composition composition;
+  Type::Flags flags{Type::Flags::None};
+  WINDOW* window{nullptr};
+  PANEL* panel{nullptr};
+  /** Set if this element created window and releases it on destruction. */
+  bool owns_window{false};
+  /** Virtual window used instead of window when virtual surfaces are
+   * enabled. */
+  std::shared_ptr<Surface> surface;
+  SceneListener* scene{nullptr};
+  /** Slot of this element in its scene's ElementStore while attached. */
+  Handle handle{};
+
+  /** @brief Returns a token that expires when this element is destroyed.
+   * @note Usable from constructors, unlike weak_from_this(). Binds event
+   * handlers to the element, see Event::GenericEvent::add(), and
+   * Event::retain() turns it into ownership of the element.
    * */
-  static std::shared_ptr<UIText> create(int x,
-                                        int y,
-                                        int width,
-                                        int height,
-                                        std::string label,
-                                        WINDOW* window);
+  std::weak_ptr<const void> lifetime();
 
-  /**@brief Creates an UI text element.
-   * @param text_x Horizontal position of the text relative to this window.
-   * @param text_y Vectical position of the text relative to this window.
-   * @param win_x Horizontal position of window
-   * @param win_y Vectical position of window.
-   * @param width Width of the window in characters.
-   * @param height Height of the window in characters.
-   * @param label String that is rendered.
-   * @param window Optional window override.
+  /** @brief Calls ncurses functions to draw UI element to its parent
+   * ScreenContext window.
+   * @note Automatically invoked by UIContext::render() during batch rendering.
+   */
+  virtual void render() = 0;
+
+  /**@brief Returns this UI element's TypeId.
+   * @warning TypeId must be registered with TypeId::register() before use.
+   * @note Automatically invoked by UIContext::handle_click() during mouse
+   * events.
    * */
-  static std::shared_ptr<UIText> create(int text_x,
-                                        int text_y,
-                                        int win_x,
-                                        int win_y,
-                                        int width,
-                                        int height,
-                                        std::string label,
-                                        WINDOW* window);
+  virtual Type::Id type() = 0;
 
-  /**@brief Render text in this current window at text_x, text_y.*/
-  void render() override;
+  /** @brief Returns the screen area covered by this element.
+   * @note Defaults to the position and size of the element's window or
+   * surface.
+   * */
+  virtual Bounds get_bounds() const;
+
+  /** @brief Returns true if both elements draw into the same window or
+   * surface. */
+  bool shares_window(const AbstractUIElement* other) const;
+
+ private:
+  std::shared_ptr<const void> _lifetime;
 };
 
-UIText::UIText(int text_x,
-               int text_y,
-               int win_x,
-               int win_y,
-               int width,
-               int height,
-               std::string label,
-               WINDOW* window)
-    : text_x(text_x),
-      text_y(text_y),
-      win_x(win_x),
-      win_y(win_y),
-      width(width),
-      height(height),
-      label(label) {
-  if (window) {
-    this->window = window;
-    wresize(this->window, height, width);
-    mvwin(this->window, win_y, win_x);
-  } else {
-    this->window = newwin(height, width, win_y, win_y);
-    panel = new_panel(this->window);
-  }
+Composition::value_type& Composition::emplace_back(value_type child) {
+  value_type& added = _children.emplace_back(std::move(child));
+  if (_owner->scene)
+    _owner->scene->element_added(_owner, added.get());
+  return added;
 }
 
-void UIText::render() {
-  mvwprintw(window, text_y, text_x, "%s", label.c_str());
-  wnoutrefresh(window);
+Composition::iterator Composition::erase(const_iterator pos) {
+  if (_owner->scene)
+    _owner->scene->element_removed(pos->get());
+  return _children.erase(pos);
 }
 
-void UIText::set_pos(int x, int y) {
-  this->win_x = x;
-  this->win_y = y;
-  mvwin(window, y, x);
-};
+template <typename F>
+size_t Composition::erase_if(F&& pred) {
+  auto removed = std::ranges::remove_if(_children, [&](const value_type& e) {
+    if (!pred(e))
+      return false;
+    if (_owner->scene)
+      _owner->scene->element_removed(e.get());
+    return true;
+  });
+  size_t count = removed.size();
+  _children.erase(removed.begin(), removed.end());
+  return count;
+}
 
-void UIText::set_label(std::string label) {
-  this->label = label;
-};
+void Composition::clear() {
+  if (_owner->scene) {
+    for (auto& child : _children) {
+      _owner->scene->element_removed(child.get());
+    }
+  }
+  _children.clear();
+}
 
-void UIText::set_dimensions(int width, int height) {
-  this->width = width;
-  this->height = height;
-  wresize(window, height, width);
-};
+std::weak_ptr<const void> AbstractUIElement::lifetime() {
+  if (!_lifetime)
+    _lifetime = resources.make<AbstractUIElement*>(this);
+  return _lifetime;
+}
 
-std::shared_ptr<UIText> _create_uitext_primitive(int text_x,
-                                                 int text_y,
-                                                 int win_x,
-                                                 int win_y,
-                                                 std::string label,
-                                                 int width = -1,
-                                                 int height = -1,
-                                                 WINDOW* window = nullptr) {
-  // center the text if no width & height is specified
-  if (width == -1) {
-    width = label.length() + 2;
-    text_x = 1;
-  }
-  if (height == -1) {
-    height = 3;
-    text_y = 1;
-  }
-  return std::make_shared<UIText>(text_x, text_y, win_x, win_y, width, height,
-                                  label, window);
+std::shared_ptr<const void> Event::retain(
+    const std::weak_ptr<const void>& owner) {
+  auto token = owner.lock();
+  if (!token)
+    return nullptr;
+  auto element = *static_cast<AbstractUIElement* const*>(token.get());
+  std::weak_ptr<AbstractUIElement> self = element->weak_from_this();
+  if (auto shared = self.lock())
+    return shared;
+  // an empty weak_ptr shares no owner, an expired one is being destroyed
+  bool owned = self.owner_before(std::weak_ptr<AbstractUIElement>{}) ||
+               std::weak_ptr<AbstractUIElement>{}.owner_before(self);
+  return owned ? nullptr : token;
 }
 
-std::shared_ptr<UIText> UIText::create(int x,
-                                       int y,
-                                       std::string label = "",
-                                       WINDOW* window = nullptr) {
-  return _create_uitext_primitive(0, 0, x, y, label, -1, -1, window);
+AbstractUIElement::~AbstractUIElement() {
+  // the panel goes first, it may still be linked to the window
+  resources.release(panel);
+  if (owns_window)
+    resources.release(window);
 }
 
-std::shared_ptr<UIText> UIText::create(int x,
-                                       int y,
-                                       int width,
-                                       int height,
-                                       std::string label = "",
-                                       WINDOW* window = nullptr) {
-  return _create_uitext_primitive(0, 0, x, y, label, width, height, window);
+bool AbstractUIElement::shares_window(const AbstractUIElement* other) const {
+  if (!other)
+    return false;
+  if (window)
+    return other->window == window;
+  return surface && other->surface == surface;
 }
 
-std::shared_ptr<UIText> create(int text_x,
-                               int text_y,
-                               int win_x,
-                               int win_y,
-                               int width,
-                               int height,
-                               std::string label,
-                               WINDOW* window) {
-  return _create_uitext_primitive(text_x, text_y, win_x, win_y, label, width,
-                                  height, window);
-};
+Bounds AbstractUIElement::get_bounds() const {
+  if (surface)
+    return Bounds{surface->x, surface->y, surface->width, surface->height};
+  if (!window)
+    return Bounds{0, 0, 0, 0};
+  Bounds b{};
+  getbegyx(window, b.y, b.x);
+  getmaxyx(window, b.height, b.width);
+  return b;
+}
 
-/**@brief UI Button element class.
- * @note Callback methods are very flexible and are allowed to have capture
- * groups.
- * @important Callback methods MUST have a parameter of type
- * Event::MouseEvent::Data.
+/** @brief Templated UI element base with shared window support and default
+ * type().
  * */
-class UIButton : public IUIElement<Type::Id::Button> {
+template <Type::Id T>
+class IUIElement : public AbstractUIElement {
  public:
-  /**@brief Default contructor. */
-  template <typename F>
-  UIButton(Event::MouseEvent* event,
-           std::string label,
-           int x,
-           int y,
-           F&& callback);
-
-  /**@brief Creates a UI button element.
-   * @param event Event handler context for the button to bind to.
-   * @param label The buttons label.
-   * @param x Horizontal position of the button.
-   * @param y Vectical position of the button.
-   * @param callback Optional callback method.
-   * @important Callback methods MUST have a parameter of type
-   * Event::MouseEvent::Data.
-   * */
-  static std::shared_ptr<UIButton> create(
-      Event::MouseEvent* event,
-      std::string label,
-      int x,
-      int y,
-      std::function<void(Event::MouseData)> callback);
-
-  void render() {};
+  explicit IUIElement(const ElementResources& res = {})
+      : AbstractUIElement(res) {}
+  IUIElement(WINDOW* window, const ElementResources& res = {})
+      : AbstractUIElement(res) {
+    this->window = window;
+    panel = res.panel(this->window);
+  }
+  Type::Id type() { return T; }
 };
 
-class UINode : public IUIElement<Type::Id::Node> {
+/** @bried UI Line element. */
+class UILine : public IUIElement<Type::Id::Line> {
  private:
-  std::vector<std::shared_ptr<UILine>> connections;
-  int x;
-  int y;
-  // std::shared_ptr<UIButton> clickable{0};
-  std::shared_ptr<UILine> current_line{0};
-  Coords line_origin{};
-
- public:
-  std::shared_ptr<UINode> self_;
-  std::function<void(Event::MouseData)> callback;
+  Coords pos1{}, pos2{};
+  /** Endpoints of the glyphs on screen, valid while shown. */
+  Coords shown1{}, shown2{};
+  int width{};
+  int height{};
+  bool dirty{true};
+  bool shown{false};
+  void _calculate_line_data();
+
+ public:
+  UILine(const Coords& pos1,
+         const Coords& pos2,
+         WINDOW* window,
+         const ElementResources& res = {});
+
+  static std::shared_ptr<UILine> create(Coords pos1,
+                                        Coords pos2,
+                                        WINDOW* window,
+                                        const ElementResources& res);
+
+  /** @brief Returns the start point of the line. */
+  Coords get_pos1() const { return pos1; }
+
+  /** @brief Returns the end point of the line. */
+  Coords get_pos2() const { return pos2; }
+
+  /** @brief Returns the bounding box of the line. */
+  Bounds get_bounds() const override {
+    return Bounds{std::min(pos1.x, pos2.x), std::min(pos1.y, pos2.y), width,
+                  height};
+  }
+
+  /** @brief Moves the line, erasing only the cells it was last drawn in.
+   * @note Lines sharing those cells are damaged and redrawn on the next
+   * render.
+   * */
+  void set_pos(Coords pos1, Coords pos2);
+
+  /** @brief Blanks the cells the line was last drawn in, if any. */
+  void erase();
+
+  /** @brief Records the current position as drawn, so the next erase()
+   * blanks it.
+   * @note For renderers drawing lines in a batch instead of render().
+   * */
+  void mark_drawn() {
+    shown1 = pos1;
+    shown2 = pos2;
+    shown = true;
+  }
+
+  /** @brief Marks the line to be redrawn on the next render. */
+  void damage() { dirty = true; }
+
+  /** @brief Returns true if the line needs redrawing and clears the flag.
+   * @note For renderers drawing lines in a batch instead of render().
+   * */
+  bool take_damage() { return std::exchange(dirty, false); }
 
+  /** @brief Visits every cell of a line with the glyph drawn there.
+   * @param f Called as f(x, y, glyph) from pos1 to pos2.
+   * */
   template <typename F>
-  UINode(Event::MouseEvent* e, int x, int y, std::string label, F&& c);
+  static void trace(Coords pos1, Coords pos2, F&& f);
 
+  /** @brief Visits the cells of steps first to last of a line, e.g. the
+   * part SegmentClipper found visible.
+   * @note Jumps to step first in constant time and visits the same cells
+   * and glyphs as trace() does for those steps.
+   * */
   template <typename F>
-  static std::shared_ptr<UINode> create(Event::MouseEvent* e,
-                                        int x,
-                                        int y,
-                                        std::string label,
-                                        F&&);
-  void render() {};
+  static void trace(Coords pos1, Coords pos2, int first, int last, F&& f);
+
+  /** @brief Draws a line between two points into a window.
+   * @param blank Draws spaces instead, erasing the line.
+   * */
+  static void draw(WINDOW* window, Coords pos1, Coords pos2, bool blank);
+
+  /** @brief Draws the line if it was moved or damaged since the last
+   * render. */
+  void render() override;
+};
+
+void UILine::_calculate_line_data() {
+  width = std::abs(pos2.x - pos1.x) + 1;
+  height = std::abs(pos2.y - pos1.y) + 1;
+}
+
+UILine::UILine(const Coords& pos1,
+               const Coords& pos2,
+               WINDOW* window,
+               const ElementResources& res)
+    : IUIElement(res), pos1(pos1), pos2(pos2) {
+  flags |= Type::Flags::Clickable;
+  _calculate_line_data();
+  if (window) {
+    this->window = window;
+    // the screen is shared by every element drawing into it
+    if (window != stdscr)
+      wresize(this->window, height, width);
+  } else {
+    this->window = stdscr;
+  }
+}
+
+std::shared_ptr<UILine> UILine::create(Coords pos1,
+                                       Coords pos2,
+                                       WINDOW* window = nullptr,
+                                       const ElementResources& res = {}) {
+  return res.make<UILine>(pos1, pos2, window);
+};
+
+void UILine::set_pos(Coords pos1, Coords pos2) {
+  if (this->pos1.x == pos1.x && this->pos1.y == pos1.y &&
+      this->pos2.x == pos2.x && this->pos2.y == pos2.y)
+    return;
+  erase();
+  this->pos1 = pos1;
+  this->pos2 = pos2;
+  _calculate_line_data();
+  dirty = true;
+  if (scene)
+    scene->element_moved(this);
+};
+
+void UILine::erase() {
+  // a line moved again before the next render has nothing new on screen
+  if (!std::exchange(shown, false))
+    return;
+  draw(window, shown1, shown2, true);
+}
+
+template <typename F>
+void UILine::trace(Coords pos1, Coords pos2, F&& f) {
+  trace(pos1, pos2, 0, std::numeric_limits<int>::max(), f);
+}
+
+template <typename F>
+void UILine::trace(Coords pos1, Coords pos2, int first, int last, F&& f) {
+  // integer Bresenham over all octants. Each cell gets the glyph of the step
+  // leaving it, the last cell continues the previous step.
+  int dx = std::abs(pos2.x - pos1.x);
+  int dy = -std::abs(pos2.y - pos1.y);
+  int sx = pos1.x < pos2.x ? 1 : -1;
+  int sy = pos1.y < pos2.y ? 1 : -1;
+  chtype diagonal = sx == sy ? '\\' : '/';
+  chtype straight = -dy > dx ? '|' : '-';
+
+  int steps = std::max(dx, -dy);
+  first = std::max(first, 0);
+  last = std::min(last, steps);
+  if (first > last)
+    return;
+  // the major axis moves every step, the minor one floor((2 * minor * k +
+  // major) / (2 * major)) times in k steps. The last cell needs the step
+  // into it, so a range starting there starts a step early.
+  int k = first == steps ? std::max(first - 1, 0) : first;
+  int64_t moved_x = k;
+  int64_t moved_y = k;
+  if (dx > -dy)
+    moved_y = (-2LL * dy * k + dx) / (2LL * dx);
+  else if (dx < -dy)
+    moved_x = (2LL * dx * k - dy) / (-2LL * dy);
+  int err = static_cast<int>(dx + dy + moved_x * dy + moved_y * dx);
+  int x = pos1.x + static_cast<int>(moved_x) * sx;
+  int y = pos1.y + static_cast<int>(moved_y) * sy;
+  chtype glyph = straight;
+  for (; k < std::min(last + 1, steps); k++) {
+    int e2 = 2 * err;
+    bool step_x = e2 >= dy;
+    bool step_y = e2 <= dx;
+    glyph = step_x && step_y ? diagonal : straight;
+    if (k >= first)
+      f(x, y, glyph);
+    if (step_x) {
+      err += dy;
+      x += sx;
+    }
+    if (step_y) {
+      err += dx;
+      y += sy;
+    }
+  }
+  if (last == steps)
+    f(x, y, glyph);
+}
+
+void UILine::draw(WINDOW* window, Coords pos1, Coords pos2, bool blank) {
+  // cells are collected into spans along the major axis, a row for shallow
+  // lines and a column for steep ones, and each span is written with one or
+  // two calls instead of one per cell
+  bool steep = std::abs(pos2.y - pos1.y) > std::abs(pos2.x - pos1.x);
+  bool reversed = steep ? pos2.y < pos1.y : pos2.x < pos1.x;
+
+  constexpr int span_max = 256;
+  chtype span[span_max];
+  int span_len{};
+  Coords start{pos1};
+
+  auto flush = [&]() {
+    if (span_len == 0)
+      return;
+    // write cells in increasing screen order, clipped at the top left
+    if (reversed)
+      std::reverse(span, span + span_len);
+    int first = steep ? (reversed ? start.y - span_len + 1 : start.y)
+                      : (reversed ? start.x - span_len + 1 : start.x);
+    int skip = std::max(0, -first);
+    if (!steep) {
+      if (skip < span_len)
+        mvwaddchnstr(window, start.y, first + skip, span + skip,
+                     span_len - skip);
+    } else {
+      for (int i = skip; i < span_len;) {
+        int j = i;
+        while (j < span_len && span[j] == span[i]) {
+          j++;
+        }
+        if (j - i == 1)
+          mvwaddchnstr(window, first + i, start.x, span + i, 1);
+        else
+          mvwvline(window, first + i, start.x, span[i], j - i);
+        i = j;
+      }
+    }
+    span_len = 0;
+  };
+
+  trace(pos1, pos2, [&](int x, int y, chtype glyph) {
+    // moving across the major axis, or a full buffer, ends the span
+    bool across = steep ? x != start.x : y != start.y;
+    if (span_len == span_max || (span_len > 0 && across))
+      flush();
+    if (span_len == 0)
+      start = Coords{x, y};
+    span[span_len++] = blank ? ' ' : glyph;
+  });
+  flush();
+}
+
+void UILine::render() {
+  if (!dirty)
+    return;
+  dirty = false;
+  draw(window, pos1, pos2, false);
+  mark_drawn();
+  wnoutrefresh(window);
+}
+
+/** @brief UI curve element, a cubic Bezier between two ports.
+ *
+ * Leaves and enters its ports horizontally like node-graph wires. The curve
+ * is flattened into a cell-space polyline when its endpoints change and the
+ * cached polyline is drawn with UILine::draw(), so redrawing a curve costs
+ * about as much as redrawing its segments as lines.
+ * */
+class UICurve : public IUIElement<Type::Id::Curve> {
+ private:
+  Coords pos1{}, pos2{};
+  /** Cached flattened curve, pos1 first. */
+  std::vector<Coords> points;
+  Bounds bounds{};
+  bool dirty{true};
+  /** Set while the points are drawn on screen. */
+  bool shown{false};
+  void _flatten();
+  void _draw(bool blank);
+  static void _draw_polyline(WINDOW* window,
+                             std::span<const Coords> points,
+                             bool blank);
+
+ public:
+  /** Maximum distance in cells between the curve and its polyline. */
+  static constexpr double tolerance = 0.5;
+
+  UICurve(const Coords& pos1,
+          const Coords& pos2,
+          WINDOW* window,
+          const ElementResources& res = {});
+
+  static std::shared_ptr<UICurve> create(Coords pos1,
+                                         Coords pos2,
+                                         WINDOW* window,
+                                         const ElementResources& res);
+
+  /** @brief Returns the start point of the curve. */
+  Coords get_pos1() const { return pos1; }
+
+  /** @brief Returns the end point of the curve. */
+  Coords get_pos2() const { return pos2; }
+
+  /** @brief Returns the cached polyline the curve is drawn with. */
+  std::span<const Coords> get_points() const { return points; }
+
+  /** @brief Returns the bounding box of the flattened curve. */
+  Bounds get_bounds() const override { return bounds; }
+
+  /** @brief Moves the curve, erasing the cells it was last drawn in and
+   * flattening it again. */
+  void set_pos(Coords pos1, Coords pos2);
+
+  /** @brief Blanks the cells the curve was last drawn in, if any. */
+  void erase();
+
+  /** @brief Marks the curve to be redrawn on the next render. */
+  void damage() { dirty = true; }
+
+  /** @brief Returns true if the curve needs redrawing and clears the flag.
+   * @note For renderers drawing curves in a batch instead of render().
+   * */
+  bool take_damage() { return std::exchange(dirty, false); }
+
+  /** @brief Flattens the curve between two ports into cell coordinates.
+   * @param out Receives the polyline, from pos1 to pos2 without repeated
+   * points.
+   * */
+  static void flatten(Coords pos1, Coords pos2, std::vector<Coords>& out);
+
+  /** @brief Draws a curve between two ports into a window.
+   * @param blank Draws spaces instead, erasing the curve.
+   * */
+  static void draw(WINDOW* window, Coords pos1, Coords pos2, bool blank);
+
+  /** @brief Draws the curve if it was moved or damaged since the last
+   * render. */
+  void render() override;
+};
+
+UICurve::UICurve(const Coords& pos1,
+                 const Coords& pos2,
+                 WINDOW* window,
+                 const ElementResources& res)
+    : IUIElement(res), pos1(pos1), pos2(pos2) {
+  flags |= Type::Flags::Clickable;
+  this->window = window ? window : stdscr;
+  _flatten();
+}
+
+std::shared_ptr<UICurve> UICurve::create(Coords pos1,
+                                         Coords pos2,
+                                         WINDOW* window = nullptr,
+                                         const ElementResources& res = {}) {
+  return res.make<UICurve>(pos1, pos2, window);
+}
+
+void UICurve::flatten(Coords pos1, Coords pos2, std::vector<Coords>& out) {
+  struct Point {
+    double x, y;
+  };
+  struct Segment {
+    Point p0, p1, p2, p3;
+    int depth;
+  };
+  constexpr int max_depth = 10;
+
+  // horizontal tangents, pulled out further the further apart the ports are
+  double pull = std::max(std::abs(pos2.x - pos1.x) / 2.0, 2.0);
+  Point p0{double(pos1.x), double(pos1.y)};
+  Point p3{double(pos2.x), double(pos2.y)};
+  Point p1{p0.x + pull, p0.y};
+  Point p2{p3.x - pull, p3.y};
+
+  auto emit = [&out](Point p) {
+    Coords c{static_cast<int>(std::lround(p.x)),
+             static_cast<int>(std::lround(p.y))};
+    if (out.empty() || out.back().x != c.x || out.back().y != c.y)
+      out.emplace_back(c);
+  };
+  // distance of a control point from the chord, scaled by the chord length
+  auto offset = [](Point p, Point a, Point b) {
+    return std::abs((b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x));
+  };
+  auto mid = [](Point a, Point b) {
+    return Point{(a.x + b.x) / 2, (a.y + b.y) / 2};
+  };
+
+  out.clear();
+  emit(p0);
+  // depth first from the start so points come out in order
+  std::vector<Segment> stack{{p0, p1, p2, p3, 0}};
+  while (!stack.empty()) {
+    Segment s = stack.back();
+    stack.pop_back();
+    double chord = std::hypot(s.p3.x - s.p0.x, s.p3.y - s.p0.y);
+    double flatness = chord > 0 ? std::max(offset(s.p1, s.p0, s.p3),
+                                           offset(s.p2, s.p0, s.p3)) /
+                                      chord
+                                : std::max(std::hypot(s.p1.x - s.p0.x,
+                                                      s.p1.y - s.p0.y),
+                                           std::hypot(s.p2.x - s.p0.x,
+                                                      s.p2.y - s.p0.y));
+    if (flatness <= tolerance || s.depth == max_depth) {
+      emit(s.p3);
+      continue;
+    }
+    // de Casteljau split at t = 0.5
+    Point a = mid(s.p0, s.p1), b = mid(s.p1, s.p2), c = mid(s.p2, s.p3);
+    Point d = mid(a, b), e = mid(b, c);
+    Point m = mid(d, e);
+    stack.emplace_back(Segment{m, e, c, s.p3, s.depth + 1});
+    stack.emplace_back(Segment{s.p0, a, d, m, s.depth + 1});
+  }
+}
+
+void UICurve::_draw_polyline(WINDOW* window,
+                             std::span<const Coords> points,
+                             bool blank) {
+  if (points.size() == 1)
+    UILine::draw(window, points[0], points[0], blank);
+  for (size_t i = 1; i < points.size(); i++) {
+    UILine::draw(window, points[i - 1], points[i], blank);
+  }
+}
+
+void UICurve::draw(WINDOW* window, Coords pos1, Coords pos2, bool blank) {
+  thread_local std::vector<Coords> points;
+  flatten(pos1, pos2, points);
+  _draw_polyline(window, points, blank);
+}
+
+void UICurve::_flatten() {
+  flatten(pos1, pos2, points);
+  int min_x{pos1.x}, min_y{pos1.y}, max_x{pos1.x}, max_y{pos1.y};
+  for (const Coords& p : points) {
+    min_x = std::min(min_x, p.x);
+    min_y = std::min(min_y, p.y);
+    max_x = std::max(max_x, p.x);
+    max_y = std::max(max_y, p.y);
+  }
+  bounds = Bounds{min_x, min_y, max_x - min_x + 1, max_y - min_y + 1};
+}
+
+void UICurve::_draw(bool blank) {
+  _draw_polyline(window, points, blank);
+}
+
+void UICurve::set_pos(Coords pos1, Coords pos2) {
+  if (this->pos1.x == pos1.x && this->pos1.y == pos1.y &&
+      this->pos2.x == pos2.x && this->pos2.y == pos2.y)
+    return;
+  erase();
+  this->pos1 = pos1;
+  this->pos2 = pos2;
+  _flatten();
+  dirty = true;
+  if (scene)
+    scene->element_moved(this);
+}
+
+void UICurve::erase() {
+  // points are only flattened again after an erase, so they are what is
+  // on screen while shown
+  if (!std::exchange(shown, false))
+    return;
+  _draw(true);
+}
+
+void UICurve::render() {
+  if (!dirty)
+    return;
+  dirty = false;
+  _draw(false);
+  shown = true;
+  wnoutrefresh(window);
+}
+
+/** @brief Primitive box element.
+ * default:
+ *  width 10 chars
+ *  height 10 chars
+ * */
+class UIBox : public IUIElement<Type::Id::Box> {
+ private:
+  size_t width{};
+  size_t height{};
+  int x{};
+  int y{};
+
+ public:
+  /** @brief Overrides the default window with a user provided window.
+   * @note Allows nested window hierarchies.
+   * */
+  UIBox(WINDOW* window, const ElementResources& res = {});
+  UIBox(WINDOW* window,
+        int w,
+        int h,
+        int xpos,
+        int ypos,
+        const ElementResources& res = {});
+
+  explicit UIBox(const ElementResources& res = {});
+  UIBox(int w, int h, int xpos, int ypos, const ElementResources& res = {});
+
+  /** @brief Returns height of the current window. */
+  int get_height() const { return height; }
+
+  /** @brief Returns width of the current window. */
+  int get_width() const { return width; }
+
+  /** @brief Returns position of the current window.
+   * @return position Coords (x,y).
+   * */
+  Coords get_pos() const { return Coords{x, y}; }
+
+  /** @brief Sets the dimensions of the window and tells the window to resize.
+   * @param w Width in characters.
+   * @param h Height in characters.
+   */
+  void set_dimensions(int w, int h);
+
+  /** @brief Sets the position of the window and tells the window to move.
+   * @param x Horizontal position
+   * @param y Vectical position
+   * */
+  void set_pos(int x, int y);
+
+  /**@brief Creates a UI box element and returns it.
+   * @param x Horizontal position
+   * @param y Vertical position
+   * @param height Height of the box
+   * @param width Width of the box
+   * @note All parameters are in characters.
+   * */
+  static std::shared_ptr<UIBox> create(int x,
+                                       int y,
+                                       int height,
+                                       int width,
+                                       WINDOW* window,
+                                       const ElementResources& res);
+
+  /** @brief Draws a box using ncurses. */
+  void render() override;
 };
 
-/** @brief RAII wrapper for ncurses screen context with UI element hierarchy
- * and event management
- *
- * Initializes ncurses with mouse support, manages screen dimensions, and owns
- * a tree of UI elements.
- *
- * Handles lifecycle (initscr/endwin), resize events, and event dispatching
- * via Event::Observer.
- *
- * @note Non-copyable/moveable to ensure exclusive ownership of ncurses state.
- * */
-class ScreenContext {
- private:
-  WINDOW* _window;
-  mmask_t _oldmask;
-  int _screen_width;
-  int _screen_height;
-  bool _running;
-  Event::Observer _observer;
-  std::vector<PANEL*> _panels;
-  std::vector<std::shared_ptr<AbstractUIElement>> _children;
-  std::vector<std::shared_ptr<AbstractUIElement>> _hit_children;
+UIBox::UIBox(WINDOW* window, const ElementResources& res)
+    : IUIElement(window, res) {};
+
+UIBox::UIBox(WINDOW* window,
+             int w,
+             int h,
+             int xpos,
+             int ypos,
+             const ElementResources& res)
+    : IUIElement(window, res), width(w), height(h), x(xpos), y(ypos) {}
+
+UIBox::UIBox(const ElementResources& res) : UIBox(10, 5, 0, 0, res) {};
+
+UIBox::UIBox(int w, int h, int xpos, int ypos, const ElementResources& res)
+    : IUIElement(res), width(w), height(h), x(xpos), y(ypos) {
+  if (res.compositor && res.compositor->enabled()) {
+    surface = res.make<Surface>(
+        Surface{.x = x, .y = y, .width = w, .height = h});
+    return;
+  }
+  window = res.window(height, width, y, x);
+  owns_window = true;
+  panel = res.panel(window);
+}
+
+void UIBox::set_dimensions(int width, int height) {
+  this->width = width;
+  this->height = height;
+  if (surface) {
+    Compositor::place(*surface, surface->x, surface->y, width, height);
+  } else {
+    wresize(window, height, width);
+  }
+  if (scene)
+    scene->element_moved(this);
+}
+
+void UIBox::set_pos(int x, int y) {
+  this->x = x;
+  this->y = y;
+  if (surface) {
+    Compositor::place(*surface, x, y, surface->width, surface->height);
+  } else {
+    mvwin(window, y, x);
+  }
+  if (scene)
+    scene->element_moved(this);
+}
+
+std::shared_ptr<UIBox> UIBox::create(int x = 0,
+                                     int y = 0,
+                                     int width = 0,
+                                     int height = 0,
+                                     WINDOW* window = nullptr,
+                                     const ElementResources& res = {}) {
+  if (window) {
+    return res.make<UIBox>(window, width, height, x, y);
+  }
+  return res.make<UIBox>(width, height, x, y);
+}
+
+void UIBox::render() {
+  if (surface) {
+    if (resources.compositor)
+      resources.compositor->draw_box(*surface);
+    return;
+  }
+  box(window, 0, 0);
+  wnoutrefresh(window);
+}
+
+/** @brief UI Text element.
+ * @note Text elements have a width, height (both are values for the window)
+ * A text position, a window position, and label content.
+ * @note Use UIText::create over directly intializing the class.
+ * @note UIText::create will automatically generate the appropriate text UI
+ * element for a given label.
+ * */
+class UIText : public IUIElement<Type::Id::Text> {
+ private:
+  std::string label;
+  size_t width;
+  size_t height;
+  int text_x;
+  int text_y;
+  int win_x;
+  int win_y;
+
+ public:
+  /**@brief Default constructor*/
+  UIText(int text_x,
+         int text_y,
+         int win_x,
+         int win_y,
+         int width,
+         int height,
+         std::string label,
+         WINDOW* window,
+         const ElementResources& res = {});
+  /**@brief Returns the x and y position of the text inside the current window.
+   */
+  Coords get_text_pos() const { return {text_x, text_y}; };
+
+  /**@brief Returns the rendered label.*/
+  const std::string& get_label() const { return label; };
+
+  /**@brief Returns the x and y position of the current window.*/
+  Coords get_window_pos() const { return {win_x, win_y}; };
+
+  /**@brief Returns the height of the window.*/
+  int get_height() const { return height; };
+
+  /**@brief Returns the width of the window.*/
+  int get_width() const { return width; };
+
+  void set_pos(int x, int y);
+
+  void set_label(std::string label);
+
+  void set_dimensions(int width, int height);
+
+  /**@brief Draws into a surface shared with another element, sizing and
+   * positioning it like a shared window.
+   * @note Virtual surface counterpart of passing a window to create().
+   * */
+  void set_surface(std::shared_ptr<Surface> surface);
+
+  /**@brief Creates an UI text element.
+   * @param x Horizontal position of window.
+   * @param y Vectical position of window.
+   * @param label String that is rendered.
+   * @param window Optional window override.
+   * @param res Resources to create the element from.
+   * */
+  static std::shared_ptr<UIText> create(int x,
+                                        int y,
+                                        std::string label,
+                                        WINDOW* window,
+                                        const ElementResources& res);
+
+  /**@brief Creates an UI text element.
+   * @param x Horizontal position of window.
+   * @param y Vectical position of window.
+   * @param width Width of the window in characters.
+   * @param height Height of the window in characters.
+   * @param label String that is rendered.
+   * @param window Optional window override.
+   * @param res Resources to create the element from.
+   * */
+  static std::shared_ptr<UIText> create(int x,
+                                        int y,
+                                        int width,
+                                        int height,
+                                        std::string label,
+                                        WINDOW* window,
+                                        const ElementResources& res);
+
+  /**@brief Creates an UI text element.
+   * @param text_x Horizontal position of the text relative to this window.
+   * @param text_y Vectical position of the text relative to this window.
+   * @param win_x Horizontal position of window
+   * @param win_y Vectical position of window.
+   * @param width Width of the window in characters.
+   * @param height Height of the window in characters.
+   * @param label String that is rendered.
+   * @param window Optional window override.
+   * */
+  static std::shared_ptr<UIText> create(int text_x,
+                                        int text_y,
+                                        int win_x,
+                                        int win_y,
+                                        int width,
+                                        int height,
+                                        std::string label,
+                                        WINDOW* window);
+
+  /**@brief Render text in this current window at text_x, text_y.*/
+  void render() override;
+};
+
+UIText::UIText(int text_x,
+               int text_y,
+               int win_x,
+               int win_y,
+               int width,
+               int height,
+               std::string label,
+               WINDOW* window,
+               const ElementResources& res)
+    : IUIElement(res),
+      text_x(text_x),
+      text_y(text_y),
+      win_x(win_x),
+      win_y(win_y),
+      width(width),
+      height(height),
+      label(label) {
+  if (window) {
+    this->window = window;
+    wresize(this->window, height, width);
+    mvwin(this->window, win_y, win_x);
+  } else if (res.compositor && res.compositor->enabled()) {
+    surface = res.make<Surface>(Surface{.x = win_x,
+                                        .y = win_y,
+                                        .width = width,
+                                        .height = height});
+  } else {
+    this->window = res.window(height, width, win_y, win_x);
+    owns_window = true;
+    panel = res.panel(this->window);
+  }
+}
+
+void UIText::render() {
+  if (surface) {
+    if (resources.compositor)
+      resources.compositor->draw_text(*surface, get_text_pos(), label);
+    return;
+  }
+  mvwprintw(window, text_y, text_x, "%s", label.c_str());
+  wnoutrefresh(window);
+}
+
+void UIText::set_surface(std::shared_ptr<Surface> surface) {
+  if (!surface)
+    return;
+  this->surface = std::move(surface);
+  Compositor::place(*this->surface, win_x, win_y, width, height);
+  if (scene)
+    scene->element_moved(this);
+}
+
+void UIText::set_pos(int x, int y) {
+  this->win_x = x;
+  this->win_y = y;
+  if (surface) {
+    Compositor::place(*surface, x, y, surface->width, surface->height);
+  } else {
+    mvwin(window, y, x);
+  }
+  if (scene)
+    scene->element_moved(this);
+};
+
+void UIText::set_label(std::string label) {
+  this->label = label;
+  if (scene)
+    scene->element_moved(this);
+};
+
+void UIText::set_dimensions(int width, int height) {
+  this->width = width;
+  this->height = height;
+  if (surface) {
+    Compositor::place(*surface, surface->x, surface->y, width, height);
+  } else {
+    wresize(window, height, width);
+  }
+  if (scene)
+    scene->element_moved(this);
+};
+
+std::shared_ptr<UIText> _create_uitext_primitive(
+    int text_x,
+    int text_y,
+    int win_x,
+    int win_y,
+    std::string label,
+    int width = -1,
+    int height = -1,
+    WINDOW* window = nullptr,
+    const ElementResources& res = {}) {
+  // center the text if no width & height is specified
+  if (width == -1) {
+    width = label.length() + 2;
+    text_x = 1;
+  }
+  if (height == -1) {
+    height = 3;
+    text_y = 1;
+  }
+  return res.make<UIText>(text_x, text_y, win_x, win_y, width, height, label,
+                          window);
+}
+
+std::shared_ptr<UIText> UIText::create(int x,
+                                       int y,
+                                       std::string label = "",
+                                       WINDOW* window = nullptr,
+                                       const ElementResources& res = {}) {
+  return _create_uitext_primitive(0, 0, x, y, label, -1, -1, window, res);
+}
+
+std::shared_ptr<UIText> UIText::create(int x,
+                                       int y,
+                                       int width,
+                                       int height,
+                                       std::string label = "",
+                                       WINDOW* window = nullptr,
+                                       const ElementResources& res = {}) {
+  return _create_uitext_primitive(0, 0, x, y, label, width, height, window,
+                                  res);
+}
+
+std::shared_ptr<UIText> create(int text_x,
+                               int text_y,
+                               int win_x,
+                               int win_y,
+                               int width,
+                               int height,
+                               std::string label,
+                               WINDOW* window) {
+  return _create_uitext_primitive(text_x, text_y, win_x, win_y, label, width,
+                                  height, window);
+};
+
+/**@brief UI Button element class.
+ * @note Callback methods are very flexible and are allowed to have capture
+ * groups.
+ * @important Callback methods MUST have a parameter of type
+ * Event::MouseEvent::Data.
+ * */
+class UIButton : public IUIElement<Type::Id::Button> {
+ public:
+  ElementCallback<Event::MouseData> callback;
+
+  /**@brief Default contructor. */
+  template <typename F>
+  UIButton(Event::MouseEvent* event,
+           std::string label,
+           int x,
+           int y,
+           F&& callback,
+           const ElementResources& res = {});
+
+  /**@brief Creates a UI button element.
+   * @param event Event handler context for the button to bind to.
+   * @param label The buttons label.
+   * @param x Horizontal position of the button.
+   * @param y Vectical position of the button.
+   * @param callback Optional callback method.
+   * @param res Resources to create the button from, callback included.
+   * @important Callback methods MUST have a parameter of type
+   * Event::MouseEvent::Data.
+   * */
+  template <typename F = std::nullptr_t>
+  static std::shared_ptr<UIButton> create(Event::MouseEvent* event,
+                                          std::string label,
+                                          int x,
+                                          int y,
+                                          F&& callback = nullptr,
+                                          const ElementResources& res = {});
+
+  void render() {};
+};
+
+/**@brief UI Node element class.
+ * @note Nodes keep track of the lines connecting them to other nodes, so
+ * moving a node only updates its own edges.
+ * */
+class UINode : public IUIElement<Type::Id::Node> {
+ private:
+  /** @brief Edge attached to this node, either a line or a curve.
+   * @note end is 0 if this node is the start of the edge, 1 otherwise.
+   * */
+  struct Connection {
+    std::shared_ptr<UILine> line{};
+    std::shared_ptr<UICurve> curve{};
+    UINode* other{};
+    int end{};
+
+    AbstractUIElement* edge() const {
+      return line ? static_cast<AbstractUIElement*>(line.get()) : curve.get();
+    }
+  };
+
+  /** @brief Adds an edge to both nodes and this node's composition. */
+  void _connect(UINode* other, Connection c);
+
+  std::vector<Connection> connections;
+  int x;
+  int y;
+  // std::shared_ptr<UIButton> clickable{0};
+  std::shared_ptr<UILine> current_line{0};
+  Coords line_origin{};
+
+ public:
+  std::shared_ptr<UINode> self_;
+  std::function<void(Event::MouseData)> callback;
+
+  template <typename F>
+  UINode(Event::MouseEvent* e,
+         int x,
+         int y,
+         std::string label,
+         F&& c,
+         const ElementResources& res = {});
+  ~UINode();
+
+  template <typename F>
+  static std::shared_ptr<UINode> create(Event::MouseEvent* e,
+                                        int x,
+                                        int y,
+                                        std::string label,
+                                        F&&,
+                                        const ElementResources& res = {});
+
+  /** @brief Returns the point edges attach to (center of the node). */
+  Coords get_anchor() const;
+
+  /** @brief Returns position of the node.
+   * @return position Coords (x,y).
+   * */
+  Coords get_pos() const { return Coords{x, y}; }
+
+  /** @brief Moves the node and re-routes only the edges attached to it.
+   * @param x Horizontal position
+   * @param y Vectical position
+   * */
+  void set_pos(int x, int y);
+
+  /** @brief Connects this node to another node with a line.
+   * @note The line is owned by this node's composition. A curve already
+   * connecting the nodes is removed and replaced by the line.
+   * @return The connecting line, the existing one if already connected by a
+   * line, or nullptr if other is null or this node.
+   * */
+  std::shared_ptr<UILine> connect(UINode* other);
+
+  /** @brief Connects this node to another node with a curve.
+   * @note The curve is owned by this node's composition. A line already
+   * connecting the nodes is removed and replaced by the curve.
+   * @return The connecting curve, the existing one if already connected by a
+   * curve, or nullptr if other is null or this node.
+   * */
+  std::shared_ptr<UICurve> connect_curve(UINode* other);
+
+  /** @brief Removes the edge connecting this node to another node.
+   * @note Safe if not connected.
+   * */
+  void disconnect(UINode* other);
+
+  /** @brief Returns the number of edges attached to this node. */
+  size_t degree() const { return connections.size(); }
+
+  void render() {};
+};
+
+UINode::~UINode() {
+  while (!connections.empty()) {
+    disconnect(connections.back().other);
+  }
+}
+
+Coords UINode::get_anchor() const {
+  Bounds b = get_bounds();
+  return Coords{x + b.width / 2, y + b.height / 2};
+}
+
+void UINode::set_pos(int x, int y) {
+  if (this->x == x && this->y == y)
+    return;
+  this->x = x;
+  this->y = y;
+  if (surface) {
+    Compositor::place(*surface, x, y, surface->width, surface->height);
+  } else {
+    mvwin(window, y, x);
+  }
+
+  Coords anchor = get_anchor();
+  for (auto& c : connections) {
+    if (c.curve) {
+      if (c.end == 0)
+        c.curve->set_pos(anchor, c.curve->get_pos2());
+      else
+        c.curve->set_pos(c.curve->get_pos1(), anchor);
+    } else if (c.end == 0) {
+      c.line->set_pos(anchor, c.line->get_pos2());
+    } else {
+      c.line->set_pos(c.line->get_pos1(), anchor);
+    }
+  }
+  if (scene)
+    scene->element_moved(this);
+}
+
+std::shared_ptr<UILine> UINode::connect(UINode* other) {
+  if (!other || other == this)
+    return nullptr;
+  for (auto& c : connections) {
+    if (c.other != other)
+      continue;
+    if (c.line)
+      return c.line;
+    disconnect(other);
+    break;
+  }
+
+  auto line = UILine::create(get_anchor(), other->get_anchor(), nullptr,
+                             resources);
+  _connect(other, Connection{.line = line, .curve = nullptr, .other = other,
+                             .end = 0});
+  return line;
+}
+
+std::shared_ptr<UICurve> UINode::connect_curve(UINode* other) {
+  if (!other || other == this)
+    return nullptr;
+  for (auto& c : connections) {
+    if (c.other != other)
+      continue;
+    if (c.curve)
+      return c.curve;
+    disconnect(other);
+    break;
+  }
+
+  auto curve = UICurve::create(get_anchor(), other->get_anchor(), nullptr,
+                               resources);
+  _connect(other, Connection{.line = nullptr, .curve = curve, .other = other,
+                             .end = 0});
+  return curve;
+}
+
+void UINode::_connect(UINode* other, Connection c) {
+  c.other = other;
+  c.end = 0;
+  connections.emplace_back(c);
+  c.other = this;
+  c.end = 1;
+  other->connections.emplace_back(c);
+
+  std::shared_ptr<AbstractUIElement> edge = c.line;
+  if (!edge)
+    edge = c.curve;
+  composition.emplace_back(edge);
+}
+
+void UINode::disconnect(UINode* other) {
+  if (!other)
+    return;
+  auto it = std::ranges::find_if(
+      connections, [&](const Connection& c) { return c.other == other; });
+  if (it == connections.end())
+    return;
+
+  AbstractUIElement* edge = it->edge();
+  connections.erase(it);
+  std::erase_if(other->connections,
+                [&](const Connection& c) { return c.edge() == edge; });
+
+  // the edge lives in the composition of the node that created it
+  auto owned_by = [edge](const std::shared_ptr<AbstractUIElement>& e) {
+    return e.get() == edge;
+  };
+  UINode* owner = other;
+  if (std::ranges::find_if(composition, owned_by) != composition.end())
+    owner = this;
+  owner->composition.erase_if(owned_by);
+}
+
+/** @brief Uniform grid spatial index over line segments.
+ *
+ * Every owner indexes one polyline, a single segment for lines. Segments are
+ * bucketed into square grid cells along the cells they actually cross, so
+ * queries only visit the buckets around the query point instead of scanning
+ * every segment.
+ * @note All coordinates and tolerances are in characters.
+ * */
+class SegmentIndex {
+ private:
+  struct Segment {
+    Coords a;
+    Coords b;
+    uint32_t entry;
+  };
+
+  struct Entry {
+    AbstractUIElement* owner;
+    std::vector<uint32_t> segments;
+  };
+
+  int _bucket_size;
+  std::vector<Segment> _segments;
+  std::vector<uint32_t> _free;
+  std::vector<Entry> _entries;
+  std::vector<uint32_t> _free_entries;
+  std::unordered_map<AbstractUIElement*, uint32_t> _ids;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> _buckets;
+  /** Visit stamps of segments for query(). */
+  mutable std::vector<uint32_t> _stamps;
+  /** Visit stamps of entries for for_each_near(). */
+  mutable std::vector<uint32_t> _entry_stamps;
+  mutable uint32_t _stamp{};
+
+  int bucket_of(int v) const;
+  static uint64_t key(int bx, int by);
+  uint32_t next_stamp() const;
+
+  template <typename F>
+  void for_each_bucket(Coords a, Coords b, F&& f) const;
+
+  void link(uint32_t id);
+  void unlink(uint32_t id);
+  void unlink_entry(Entry& entry);
+
+ public:
+  explicit SegmentIndex(int bucket_size = 8);
+
+  /** @brief Inserts or updates the segment owned by an element.
+   * @param owner Element the segment belongs to (used as the key).
+   * @param a Start point.
+   * @param b End point.
+   * @return True if the indexed geometry changed.
+   * */
+  bool update(AbstractUIElement* owner, Coords a, Coords b);
+
+  /** @brief Inserts or updates the polyline owned by an element.
+   * @param owner Element the polyline belongs to (used as the key).
+   * @param points Polyline vertices, a single point indexes that point.
+   * Removes the owner if empty.
+   * @return True if the indexed geometry changed.
+   * */
+  bool update(AbstractUIElement* owner, std::span<const Coords> points);
+
+  /** @brief Removes the segments owned by an element.
+   * @note Safe if not found.
+   * */
+  void remove(AbstractUIElement* owner);
+
+  /** @brief Removes every segment from the index. */
+  void clear();
+
+  /** @brief Returns the number of indexed owners. */
+  size_t size() const { return _ids.size(); }
+
+  /** @brief Finds the segment closest to a point.
+   * @param x Horizontal position.
+   * @param y Vertical position.
+   * @param tolerance Maximum distance from the segment.
+   * @return Owner of the closest segment or nullptr if none is within
+   * tolerance.
+   * */
+  AbstractUIElement* query(int x, int y, int tolerance) const;
+
+  /** @brief Visits the owners of segments sharing grid buckets with the
+   * segments of an element, excluding the element itself.
+   * @note Candidates may not actually intersect the segments. Each owner is
+   * visited once.
+   * */
+  template <typename F>
+  void for_each_near(AbstractUIElement* owner, F&& f) const;
+
+  /** @brief Visits every indexed owner. */
+  template <typename F>
+  void for_each(F&& f) const {
+    for (auto& [owner, id] : _ids) {
+      f(owner);
+    }
+  }
+
+  /** @brief Returns the euclidean distance from point p to segment ab. */
+  static double distance(Coords p, Coords a, Coords b);
+};
+
+SegmentIndex::SegmentIndex(int bucket_size)
+    : _bucket_size(std::max(1, bucket_size)) {}
+
+int SegmentIndex::bucket_of(int v) const {
+  // floor division so negative coordinates land in their own buckets
+  return v >= 0 ? v / _bucket_size : -((-v - 1) / _bucket_size) - 1;
+}
+
+uint64_t SegmentIndex::key(int bx, int by) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(bx)) << 32) |
+         static_cast<uint32_t>(by);
+}
+
+uint32_t SegmentIndex::next_stamp() const {
+  if (++_stamp == 0) {
+    std::fill(_stamps.begin(), _stamps.end(), 0);
+    std::fill(_entry_stamps.begin(), _entry_stamps.end(), 0);
+    _stamp = 1;
+  }
+  return _stamp;
+}
+
+template <typename F>
+void SegmentIndex::for_each_bucket(Coords a, Coords b, F&& f) const {
+  if (a.x > b.x)
+    std::swap(a, b);
+
+  int bx0 = bucket_of(a.x);
+  int bx1 = bucket_of(b.x);
+
+  for (int bx{bx0}; bx <= bx1; bx++) {
+    // clip the segment to the real x extent of this bucket column, which
+    // runs up to the start of the next column, and visit the rows it spans
+    int cx0 = std::max(a.x, bx * _bucket_size);
+    int cx1 = std::min(b.x, (bx + 1) * _bucket_size);
+    int y0 = a.y;
+    int y1 = b.y;
+    if (a.x != b.x) {
+      double gradient = (double)(b.y - a.y) / (double)(b.x - a.x);
+      double fy0 = a.y + gradient * (cx0 - a.x);
+      double fy1 = a.y + gradient * (cx1 - a.x);
+      if (fy0 > fy1)
+        std::swap(fy0, fy1);
+      y0 = static_cast<int>(std::floor(fy0));
+      y1 = static_cast<int>(std::ceil(fy1));
+    }
+    if (y0 > y1)
+      std::swap(y0, y1);
+    for (int by{bucket_of(y0)}; by <= bucket_of(y1); by++) {
+      f(key(bx, by));
+    }
+  }
+}
+
+void SegmentIndex::link(uint32_t id) {
+  const Segment& s = _segments[id];
+  for_each_bucket(s.a, s.b,
+                  [&](uint64_t k) { _buckets[k].emplace_back(id); });
+}
+
+void SegmentIndex::unlink(uint32_t id) {
+  const Segment& s = _segments[id];
+  for_each_bucket(s.a, s.b, [&](uint64_t k) {
+    auto it = _buckets.find(k);
+    if (it == _buckets.end())
+      return;
+    auto& ids = it->second;
+    auto pos = std::find(ids.begin(), ids.end(), id);
+    if (pos != ids.end()) {
+      *pos = ids.back();
+      ids.pop_back();
+    }
+    if (ids.empty())
+      _buckets.erase(it);
+  });
+}
+
+void SegmentIndex::unlink_entry(Entry& entry) {
+  for (uint32_t id : entry.segments) {
+    unlink(id);
+    _free.emplace_back(id);
+  }
+  entry.segments.clear();
+}
+
+bool SegmentIndex::update(AbstractUIElement* owner, Coords a, Coords b) {
+  Coords points[]{a, b};
+  return update(owner, points);
+}
+
+bool SegmentIndex::update(AbstractUIElement* owner,
+                          std::span<const Coords> points) {
+  if (!owner)
+    return false;
+  if (points.empty()) {
+    bool found = _ids.contains(owner);
+    remove(owner);
+    return found;
+  }
+  // a single point is indexed as a zero length segment
+  size_t count = std::max<size_t>(points.size() - 1, 1);
+  auto vertex = [&](size_t i) {
+    return points[std::min(i, points.size() - 1)];
+  };
+
+  auto it = _ids.find(owner);
+  uint32_t entry{};
+  if (it != _ids.end()) {
+    entry = it->second;
+    const auto& ids = _entries[entry].segments;
+    bool same = ids.size() == count;
+    for (size_t i{}; same && i < count; i++) {
+      const Segment& s = _segments[ids[i]];
+      Coords a = vertex(i), b = vertex(i + 1);
+      same = s.a.x == a.x && s.a.y == a.y && s.b.x == b.x && s.b.y == b.y;
+    }
+    if (same)
+      return false;
+    unlink_entry(_entries[entry]);
+  } else if (!_free_entries.empty()) {
+    entry = _free_entries.back();
+    _free_entries.pop_back();
+    _ids.emplace(owner, entry);
+  } else {
+    entry = static_cast<uint32_t>(_entries.size());
+    _entries.emplace_back();
+    _entry_stamps.emplace_back(0);
+    _ids.emplace(owner, entry);
+  }
+  _entries[entry].owner = owner;
+
+  for (size_t i{}; i < count; i++) {
+    uint32_t id{};
+    if (!_free.empty()) {
+      id = _free.back();
+      _free.pop_back();
+    } else {
+      id = static_cast<uint32_t>(_segments.size());
+      _segments.emplace_back();
+      _stamps.emplace_back(0);
+    }
+    _segments[id] =
+        Segment{.a = vertex(i), .b = vertex(i + 1), .entry = entry};
+    _entries[entry].segments.emplace_back(id);
+    link(id);
+  }
+  return true;
+}
+
+void SegmentIndex::remove(AbstractUIElement* owner) {
+  auto it = _ids.find(owner);
+  if (it == _ids.end())
+    return;
+  Entry& entry = _entries[it->second];
+  unlink_entry(entry);
+  entry.owner = nullptr;
+  _free_entries.emplace_back(it->second);
+  _ids.erase(it);
+}
+
+void SegmentIndex::clear() {
+  _segments.clear();
+  _free.clear();
+  _entries.clear();
+  _free_entries.clear();
+  _ids.clear();
+  _buckets.clear();
+  _stamps.clear();
+  _entry_stamps.clear();
+  _stamp = 0;
+}
+
+template <typename F>
+void SegmentIndex::for_each_near(AbstractUIElement* owner, F&& f) const {
+  auto it = _ids.find(owner);
+  if (it == _ids.end())
+    return;
+  uint32_t stamp = next_stamp();
+  _entry_stamps[it->second] = stamp;
+
+  for (uint32_t own : _entries[it->second].segments) {
+    const Segment& s = _segments[own];
+    for_each_bucket(s.a, s.b, [&](uint64_t k) {
+      auto bucket = _buckets.find(k);
+      if (bucket == _buckets.end())
+        return;
+      for (uint32_t id : bucket->second) {
+        uint32_t entry = _segments[id].entry;
+        if (_entry_stamps[entry] == stamp)
+          continue;
+        _entry_stamps[entry] = stamp;
+        f(_entries[entry].owner);
+      }
+    });
+  }
+}
+
+double SegmentIndex::distance(Coords p, Coords a, Coords b) {
+  double dx = b.x - a.x;
+  double dy = b.y - a.y;
+  double px = p.x - a.x;
+  double py = p.y - a.y;
+  double len = dx * dx + dy * dy;
+  double t = len == 0 ? 0 : std::clamp((px * dx + py * dy) / len, 0.0, 1.0);
+  return std::hypot(px - t * dx, py - t * dy);
+}
+
+AbstractUIElement* SegmentIndex::query(int x, int y, int tolerance) const {
+  if (_ids.empty())
+    return nullptr;
+
+  // stamps dedupe segments that span several of the visited buckets
+  uint32_t stamp = next_stamp();
+
+  AbstractUIElement* best{nullptr};
+  double best_distance = tolerance;
+  Coords p{x, y};
+
+  for (int bx{bucket_of(x - tolerance)}; bx <= bucket_of(x + tolerance);
+       bx++) {
+    for (int by{bucket_of(y - tolerance)}; by <= bucket_of(y + tolerance);
+         by++) {
+      auto it = _buckets.find(key(bx, by));
+      if (it == _buckets.end())
+        continue;
+      for (uint32_t id : it->second) {
+        if (_stamps[id] == stamp)
+          continue;
+        _stamps[id] = stamp;
+        const Segment& s = _segments[id];
+        double d = distance(p, s.a, s.b);
+        if (d <= best_distance) {
+          best_distance = d;
+          best = _entries[s.entry].owner;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+/** @brief Ordered z-index stack of UI elements.
+ *
+ * Elements are ordered by z_index, and by insertion order for equal
+ * z_index. Insert, erase and restack are O(log n).
+ * @note Iterates back to front, i.e. in render order.
+ * */
+class ZOrder {
+ private:
+  struct Key {
+    int z;
+    uint64_t seq;
+    bool operator<(const Key& other) const {
+      return z != other.z ? z < other.z : seq < other.seq;
+    }
+  };
+
+  std::map<Key, std::shared_ptr<AbstractUIElement>> _stack;
+  std::unordered_map<AbstractUIElement*, Key> _keys;
+  uint64_t _seq{};
+
+ public:
+  auto begin() const { return std::views::values(_stack).begin(); }
+  auto end() const { return std::views::values(_stack).end(); }
+
+  size_t size() const { return _stack.size(); }
+  bool empty() const { return _stack.empty(); }
+  bool contains(AbstractUIElement* element) const {
+    return _keys.contains(element);
+  }
+
+  /** @brief Returns the element directly below another one.
+   * @return Element below, or nullptr if element is at the bottom or not
+   * found.
+   * */
+  AbstractUIElement* below(AbstractUIElement* element) const;
+
+  /** @brief Inserts an element in front of all elements with the same
+   * z_index.
+   * @note Does nothing if the element is already in the stack.
+   * */
+  void insert(std::shared_ptr<AbstractUIElement> element);
+
+  /** @brief Removes an element from the stack.
+   * @return True if the element was found.
+   * */
+  bool erase(AbstractUIElement* element);
+
+  /** @brief Repositions an element after its z_index changed.
+   * @note Keeps its order relative to elements with the same z_index.
+   * */
+  void restack(AbstractUIElement* element);
+
+  /** @brief Moves an element in front of all elements with the same
+   * z_index. */
+  void bring_to_front(AbstractUIElement* element);
+
+  void clear();
+};
+
+void ZOrder::insert(std::shared_ptr<AbstractUIElement> element) {
+  if (!element || contains(element.get()))
+    return;
+  Key key{.z = element->z_index, .seq = _seq++};
+  _keys.emplace(element.get(), key);
+  _stack.emplace(key, std::move(element));
+}
+
+bool ZOrder::erase(AbstractUIElement* element) {
+  auto it = _keys.find(element);
+  if (it == _keys.end())
+    return false;
+  _stack.erase(it->second);
+  _keys.erase(it);
+  return true;
+}
+
+void ZOrder::restack(AbstractUIElement* element) {
+  auto it = _keys.find(element);
+  if (it == _keys.end() || it->second.z == element->z_index)
+    return;
+  auto node = _stack.extract(it->second);
+  it->second.z = element->z_index;
+  node.key() = it->second;
+  _stack.insert(std::move(node));
+}
+
+void ZOrder::bring_to_front(AbstractUIElement* element) {
+  auto it = _keys.find(element);
+  if (it == _keys.end())
+    return;
+  auto node = _stack.extract(it->second);
+  it->second = Key{.z = element->z_index, .seq = _seq++};
+  node.key() = it->second;
+  _stack.insert(std::move(node));
+}
+
+AbstractUIElement* ZOrder::below(AbstractUIElement* element) const {
+  auto it = _keys.find(element);
+  if (it == _keys.end())
+    return nullptr;
+  auto pos = _stack.find(it->second);
+  if (pos == _stack.begin())
+    return nullptr;
+  return std::prev(pos)->second.get();
+}
+
+void ZOrder::clear() {
+  _stack.clear();
+  _keys.clear();
+}
+
+/** @brief Registry mirroring the ncurses panel deck of top level elements.
+ *
+ * Keeps exactly one entry per live panel, grouped by the top level element
+ * that owns it. Groups placed at the top or bottom of the deck are restacked
+ * immediately with top_panel/bottom_panel, groups placed in between are
+ * restacked together with everything above them on the next flush().
+ * @note Restacking reaches the screen through the update_panels() call of
+ * UIContext::batch_render().
+ * */
+class PanelRegistry {
+ private:
+  struct Group {
+    AbstractUIElement* owner;
+    std::vector<PANEL*> panels;
+    bool dirty;
+  };
+
+  std::list<Group> _deck;
+  std::unordered_map<AbstractUIElement*, std::list<Group>::iterator> _groups;
+  std::unordered_map<PANEL*, AbstractUIElement*> _panels;
+  bool _dirty{false};
+
+  void collect(AbstractUIElement* element, Group& group);
+  void sync(std::list<Group>::iterator group);
+
+ public:
+  /** @brief Registers or moves the panels of a top level element so they
+   * sit directly above the panels of another element.
+   * @param owner Top level element owning the panels.
+   * @param below Element directly below owner, or nullptr for the bottom.
+   * */
+  void place(AbstractUIElement* owner, AbstractUIElement* below);
+
+  /** @brief Unregisters the panels of a top level element.
+   * @note Safe if not found.
+   * */
+  void remove(AbstractUIElement* owner);
+
+  /** @brief Restacks groups placed between others since the last flush.
+   * @note Called automatically before each batch render.
+   * */
+  void flush();
+
+  void clear();
+
+  /** @brief Returns the number of registered panels. */
+  size_t size() const { return _panels.size(); }
+};
+
+void PanelRegistry::collect(AbstractUIElement* element, Group& group) {
+  if (!element)
+    return;
+  // compositions render below their parent
+  for (auto& child : element->composition) {
+    collect(child.get(), group);
+  }
+  if (element->panel && _panels.emplace(element->panel, group.owner).second) {
+    group.panels.emplace_back(element->panel);
+  }
+}
+
+void PanelRegistry::sync(std::list<Group>::iterator group) {
+  if (std::next(group) == _deck.end()) {
+    // new_panel already stacks fresh panels on top, and top_panel is not
+    // free, so skip groups that are already in place
+    auto& panels = group->panels;
+    bool in_place = true;
+    for (size_t i{}; in_place && i < panels.size(); i++) {
+      in_place = panel_above(panels[i]) ==
+                 (i + 1 < panels.size() ? panels[i + 1] : nullptr);
+    }
+    if (in_place)
+      return;
+    for (PANEL* p : panels) {
+      top_panel(p);
+    }
+    return;
+  }
+  if (group == _deck.begin()) {
+    for (PANEL* p : std::ranges::reverse_view(group->panels)) {
+      bottom_panel(p);
+    }
+    return;
+  }
+  group->dirty = true;
+  _dirty = true;
+}
+
+void PanelRegistry::flush() {
+  if (!_dirty)
+    return;
+  auto it = std::ranges::find_if(_deck, [](const Group& g) { return g.dirty; });
+  for (; it != _deck.end(); it++) {
+    it->dirty = false;
+    for (PANEL* p : it->panels) {
+      top_panel(p);
+    }
+  }
+  _dirty = false;
+}
+
+void PanelRegistry::place(AbstractUIElement* owner, AbstractUIElement* below) {
+  if (!owner)
+    return;
+
+  auto pos = _deck.begin();
+  if (below) {
+    auto found = _groups.find(below);
+    if (found != _groups.end())
+      pos = std::next(found->second);
+  }
+
+  auto it = _groups.find(owner);
+  if (it == _groups.end()) {
+    auto group = _deck.emplace(pos, Group{.owner = owner, .panels = {}, .dirty = false});
+    collect(owner, *group);
+    _groups.emplace(owner, group);
+    sync(group);
+    return;
+  }
+
+  if (it->second == pos || std::next(it->second) == pos)
+    return;
+  _deck.splice(pos, _deck, it->second);
+  sync(it->second);
+}
+
+void PanelRegistry::remove(AbstractUIElement* owner) {
+  auto it = _groups.find(owner);
+  if (it == _groups.end())
+    return;
+  for (PANEL* p : it->second->panels) {
+    _panels.erase(p);
+  }
+  _deck.erase(it->second);
+  _groups.erase(it);
+}
+
+void PanelRegistry::clear() {
+  _deck.clear();
+  _groups.clear();
+  _panels.clear();
+  _dirty = false;
+}
+
+/** @brief Structure-of-arrays store of attached UI element state.
+ *
+ * Every attached element owns one slot addressed by a generational Handle.
+ * Geometry, flags, z_index, type, parent and hit order are kept in parallel
+ * contiguous arrays so scene-wide traversals (hit testing, culling) stream
+ * through memory instead of chasing element pointers.
+ * @note Elements keep their own state and write it through to their slot
+ * whenever they report a change to their scene.
+ * */
+class ElementStore {
+ public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<int> width;
+  std::vector<int> height;
+  std::vector<Type::Flags> flags;
+  std::vector<int> z_index;
+  std::vector<Type::Id> type;
+  std::vector<uint32_t> parent;
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> generation;
+  std::vector<AbstractUIElement*> element;
+
+ private:
+  std::vector<uint32_t> _free;
+  size_t _size{};
+
+ public:
+  /** @brief Allocates a slot for an element.
+   * @param e Element the slot mirrors.
+   * @param parent_handle Handle of the parent element, or an invalid handle
+   * for top level elements.
+   * */
+  Handle create(AbstractUIElement* e, Handle parent_handle);
+
+  /** @brief Frees the slot of a handle.
+   * @note Safe on stale handles.
+   * */
+  void destroy(Handle h);
+
+  /** @brief Copies the current state of the element into its slot. */
+  void update(Handle h);
+
+  /** @brief Returns true if the handle refers to a live slot. */
+  bool alive(Handle h) const {
+    return h.index < generation.size() &&
+           generation[h.index] == h.generation && element[h.index];
+  }
+
+  /** @brief Returns the element of a live handle, otherwise nullptr. */
+  AbstractUIElement* get(Handle h) const {
+    return alive(h) ? element[h.index] : nullptr;
+  }
+
+  /** @brief Returns the number of live slots. */
+  size_t size() const { return _size; }
+
+  /** @brief Returns the number of allocated slots. */
+  size_t capacity() const { return element.size(); }
+
+  /** @brief Returns the index of the top level ancestor of a slot. */
+  uint32_t root(uint32_t index) const;
+
+  /** @brief Marks the slots whose bounds intersect a rectangle.
+   * @param rect Rectangle to cull against, e.g. the screen.
+   * @param visible Resized to capacity(), 1 for intersecting slots, else 0.
+   * @note A single pass over the geometry arrays without branches. Free
+   * slots keep the geometry of their last element, their marks mean nothing.
+   * */
+  void cull(Bounds rect, std::vector<uint8_t>& visible) const;
+
+  void clear();
+};
+
+Handle ElementStore::create(AbstractUIElement* e, Handle parent_handle) {
+  uint32_t index{};
+  if (!_free.empty()) {
+    index = _free.back();
+    _free.pop_back();
+  } else {
+    index = static_cast<uint32_t>(element.size());
+    x.emplace_back();
+    y.emplace_back();
+    width.emplace_back();
+    height.emplace_back();
+    flags.emplace_back();
+    z_index.emplace_back();
+    type.emplace_back();
+    parent.emplace_back();
+    order.emplace_back();
+    generation.emplace_back();
+    element.emplace_back();
+  }
+  element[index] = e;
+  parent[index] = alive(parent_handle) ? parent_handle.index : npos;
+  order[index] = 0;
+  _size++;
+
+  Handle h{.index = index, .generation = generation[index]};
+  update(h);
+  return h;
+}
+
+void ElementStore::destroy(Handle h) {
+  if (!alive(h))
+    return;
+  element[h.index] = nullptr;
+  generation[h.index]++;
+  _free.emplace_back(h.index);
+  _size--;
+}
+
+void ElementStore::update(Handle h) {
+  if (!alive(h))
+    return;
+  uint32_t i = h.index;
+  AbstractUIElement* e = element[i];
+  Bounds b = e->get_bounds();
+  x[i] = b.x;
+  y[i] = b.y;
+  width[i] = b.width;
+  height[i] = b.height;
+  flags[i] = e->flags;
+  z_index[i] = e->z_index;
+  type[i] = e->type();
+}
+
+uint32_t ElementStore::root(uint32_t index) const {
+  while (parent[index] != npos) {
+    index = parent[index];
+  }
+  return index;
+}
+
+void ElementStore::cull(Bounds rect, std::vector<uint8_t>& visible) const {
+  visible.resize(element.size());
+  int x1 = rect.x + rect.width;
+  int y1 = rect.y + rect.height;
+  for (size_t i{}; i < visible.size(); i++) {
+    visible[i] = (x[i] < x1) & (x[i] + width[i] > rect.x) & (y[i] < y1) &
+                 (y[i] + height[i] > rect.y);
+  }
+}
+
+void ElementStore::clear() {
+  // slots are kept so generations of stale handles stay invalid
+  _free.clear();
+  for (uint32_t i{static_cast<uint32_t>(element.size())}; i > 0; i--) {
+    if (element[i - 1]) {
+      element[i - 1] = nullptr;
+      generation[i - 1]++;
+    }
+    _free.emplace_back(i - 1);
+  }
+  _size = 0;
+}
+
+/** @brief Immutable copy of one ElementStore slot in a SceneSnapshot. */
+struct SceneRecord {
+  Bounds bounds;
+  /** Text position for Text, start point for Line and Curve. */
+  Coords a;
+  /** End point for Line and Curve. */
+  Coords b;
+  Type::Id type;
+  Type::Flags flags;
+  int z_index;
+  uint32_t parent;
+  uint32_t order;
+  uint32_t generation;
+  /** Label for Text. */
+  std::string text;
+  bool alive;
+};
+
+/** @brief Persistent, structurally shared view of the scene.
+ *
+ * Slots are stored in fixed size chunks, and chunks in fixed size pages,
+ * shared between snapshots. Taking a snapshot is O(1) and the next change
+ * copies only the small table of pages and the page and chunk it writes to,
+ * so snapshots kept for a render thread or as undo history cost memory in
+ * proportion to the elements changed between them.
+ * @note Never changes after creation, safe to read from another thread.
+ * */
+class SceneSnapshot {
+ public:
+  static constexpr uint32_t chunk_size = 64;
+  /** Chunks per page. */
+  static constexpr uint32_t page_size = 64;
+  using Chunk = std::array<SceneRecord, chunk_size>;
+  /** Chunks of a page, null until a slot of theirs is written. */
+  using Page = std::array<std::shared_ptr<Chunk>, page_size>;
+  using Table = std::vector<std::shared_ptr<Page>>;
+
+ private:
+  std::shared_ptr<const Table> _table;
+  size_t _capacity{};
+  uint64_t _version{};
+
+  friend class SnapshotWriter;
+
+  /** @brief Returns a chunk of a covered page, or nullptr if unwritten. */
+  const Chunk* chunk(uint32_t c) const {
+    return (*(*_table)[c / page_size])[c % page_size].get();
+  }
+
+ public:
+  /** @brief Returns the scene version the snapshot was taken at. */
+  uint64_t version() const { return _version; }
+
+  /** @brief Returns the number of slots covered. */
+  size_t capacity() const { return _capacity; }
+
+  /** @brief Returns the record of a live slot, otherwise nullptr. */
+  const SceneRecord* at(uint32_t index) const;
+
+  /** @brief Returns the record of a handle if it was live when the snapshot
+   * was taken, otherwise nullptr. */
+  const SceneRecord* get(Handle h) const;
+
+  /** @brief Visits the index and record of every live slot. */
+  template <typename F>
+  void for_each(F&& f) const;
+
+  /** @brief Visits the index of every slot that may differ from another
+   * snapshot.
+   * @note Chunks shared by both snapshots are skipped without looking at
+   * their slots.
+   * */
+  template <typename F>
+  void for_each_changed(const SceneSnapshot& other, F&& f) const;
+
+  /** @brief Returns the number of chunks shared with another snapshot. */
+  size_t shared_chunks(const SceneSnapshot& other) const;
+};
+
+const SceneRecord* SceneSnapshot::at(uint32_t index) const {
+  if (index >= _capacity)
+    return nullptr;
+  const Chunk* c = chunk(index / chunk_size);
+  if (!c)
+    return nullptr;
+  const SceneRecord& record = (*c)[index % chunk_size];
+  return record.alive ? &record : nullptr;
+}
+
+const SceneRecord* SceneSnapshot::get(Handle h) const {
+  const SceneRecord* record = at(h.index);
+  return record && record->generation == h.generation ? record : nullptr;
+}
+
+template <typename F>
+void SceneSnapshot::for_each(F&& f) const {
+  for (uint32_t i{}; i < _capacity; i += chunk_size) {
+    const Chunk* c = chunk(i / chunk_size);
+    if (!c)
+      continue;
+    for (uint32_t j = i; j < std::min<size_t>(i + chunk_size, _capacity); j++) {
+      const SceneRecord& record = (*c)[j - i];
+      if (record.alive)
+        f(j, record);
+    }
+  }
+}
+
+template <typename F>
+void SceneSnapshot::for_each_changed(const SceneSnapshot& other, F&& f) const {
+  constexpr uint32_t page_slots = chunk_size * page_size;
+  size_t capacity = std::max(_capacity, other._capacity);
+  for (uint32_t i{}; i < capacity; i += chunk_size) {
+    uint32_t c = i / chunk_size;
+    if (i < _capacity && i < other._capacity) {
+      // a page is only shared while none of its slots were written
+      if ((*_table)[c / page_size] == (*other._table)[c / page_size]) {
+        i = (i / page_slots + 1) * page_slots - chunk_size;
+        continue;
+      }
+      if (chunk(c) == other.chunk(c))
+        continue;
+    }
+    for (uint32_t j = i; j < std::min<size_t>(i + chunk_size, capacity); j++) {
+      f(j);
+    }
+  }
+}
+
+size_t SceneSnapshot::shared_chunks(const SceneSnapshot& other) const {
+  if (!_table || !other._table)
+    return 0;
+  size_t shared{};
+  size_t pages = std::min(_table->size(), other._table->size());
+  for (size_t p{}; p < pages; p++) {
+    const Page& page = *(*_table)[p];
+    const Page& other_page = *(*other._table)[p];
+    for (uint32_t c{}; c < page_size; c++) {
+      shared += page[c] && page[c] == other_page[c];
+    }
+  }
+  return shared;
+}
+
+/** @brief Mutable head of a chain of SceneSnapshots.
+ * @note Copies on write: the table, a page or a chunk is copied before the
+ * first write after a snapshot published it. Published parts are never
+ * written again, whoever still holds them.
+ * */
+class SnapshotWriter {
+ private:
+  std::shared_ptr<SceneSnapshot::Table> _table;
+  size_t _capacity{};
+  /** Bumped by every snapshot, parts created in an older epoch were
+   * published. */
+  uint64_t _epoch{1};
+  uint64_t _table_epoch{};
+  /** Epoch every page and chunk was created or copied in, 0 for none. */
+  std::vector<uint64_t> _page_epoch;
+  std::vector<uint64_t> _chunk_epoch;
+
+  SceneRecord& slot(uint32_t index);
+
+ public:
+  /** @brief Writes the record of a slot. */
+  void write(uint32_t index, SceneRecord record);
+
+  /** @brief Marks a slot as free. */
+  void erase(uint32_t index);
+
+  /** @brief Returns a snapshot of the records written so far in O(1). */
+  SceneSnapshot snapshot(uint64_t version);
+
+  void clear();
+};
+
+SceneRecord& SnapshotWriter::slot(uint32_t index) {
+  using Snapshot = SceneSnapshot;
+  // use_count() can't tell whether another thread still reads a
+  // snapshot, so what was published is tracked by epoch instead
+  if (_table_epoch != _epoch) {
+    _table = _table ? std::make_shared<Snapshot::Table>(*_table)
+                    : std::make_shared<Snapshot::Table>();
+    _table_epoch = _epoch;
+  }
+
+  uint32_t c = index / Snapshot::chunk_size;
+  uint32_t p = c / Snapshot::page_size;
+  while (_table->size() <= p) {
+    _table->emplace_back(std::make_shared<Snapshot::Page>());
+    _page_epoch.push_back(_epoch);
+  }
+  if (_chunk_epoch.size() <= c)
+    _chunk_epoch.resize((p + 1) * Snapshot::page_size);
+  _capacity = std::max<size_t>(_capacity, index + 1);
+
+  auto& page = (*_table)[p];
+  if (_page_epoch[p] != _epoch) {
+    page = std::make_shared<Snapshot::Page>(*page);
+    _page_epoch[p] = _epoch;
+  }
+  auto& chunk = (*page)[c % Snapshot::page_size];
+  if (_chunk_epoch[c] != _epoch) {
+    chunk = chunk ? std::make_shared<Snapshot::Chunk>(*chunk)
+                  : std::make_shared<Snapshot::Chunk>();
+    _chunk_epoch[c] = _epoch;
+  }
+  return (*chunk)[index % Snapshot::chunk_size];
+}
+
+void SnapshotWriter::write(uint32_t index, SceneRecord record) {
+  record.alive = true;
+  slot(index) = std::move(record);
+}
+
+void SnapshotWriter::erase(uint32_t index) {
+  if (index >= _capacity)
+    return;
+  slot(index).alive = false;
+}
+
+SceneSnapshot SnapshotWriter::snapshot(uint64_t version) {
+  if (!_table)
+    _table = std::make_shared<SceneSnapshot::Table>();
+  // everything written so far becomes read only
+  _epoch++;
+  SceneSnapshot snapshot;
+  snapshot._table = _table;
+  snapshot._capacity = _capacity;
+  snapshot._version = version;
+  return snapshot;
+}
+
+void SnapshotWriter::clear() {
+  _table.reset();
+  _capacity = 0;
+  _table_epoch = 0;
+  _page_epoch.clear();
+  _chunk_epoch.clear();
+}
+
+/** @brief Back to front draw order of a SceneSnapshot.
+ *
+ * Collecting and sorting the records is the part of drawing a snapshot that
+ * needs no ncurses, so a worker thread can build the frame while the UI
+ * thread changes the scene, leaving only the drawing to the ncurses thread,
+ * see Renderer::render().
+ * @note Keeps its snapshot alive. Safe to build on any thread.
+ * */
+class SnapshotFrame {
+ private:
+  SceneSnapshot _snapshot;
+  std::vector<const SceneRecord*> _records;
+
+ public:
+  SnapshotFrame() = default;
+  explicit SnapshotFrame(SceneSnapshot snapshot);
+
+  const SceneSnapshot& snapshot() const { return _snapshot; }
+
+  /** @brief Returns the live records in render order. */
+  std::span<const SceneRecord* const> records() const { return _records; }
+};
+
+SnapshotFrame::SnapshotFrame(SceneSnapshot snapshot)
+    : _snapshot(std::move(snapshot)) {
+  _snapshot.for_each([this](uint32_t, const SceneRecord& record) {
+    _records.emplace_back(&record);
+  });
+  std::ranges::sort(_records, {}, &SceneRecord::order);
+}
+
+/** @brief Single draw operation of a DisplayList. */
+struct DrawCommand {
+  enum class Kind : uint8_t {
+    Box,
+    Text,
+    Line,
+    Curve,
+    /** Any other element, drawn through its virtual render(). */
+    Element,
+  };
+
+  Kind kind;
+  AbstractUIElement* element;
+  WINDOW* window;
+  /** Virtual surface drawn into instead of window, if set. */
+  Surface* surface;
+  /** Text position for Text, start point for Line and Curve. */
+  Coords a;
+  /** End point for Line and Curve. */
+  Coords b;
+  /** Copy of the label for Text, so relabeling never leaves it dangling. */
+  std::string text;
+  /** ElementStore slot of the element, see ScreenContext::cull(). */
+  uint32_t slot;
+};
+
+/** @brief Flat, z-sorted list of draw commands compiled from an element
+ * hierarchy.
+ *
+ * Rebuilt only after structural changes (attach, detach, restack); geometry
+ * and content changes patch the command of the changed element in place.
+ * Rendering is a single linear pass over the command array. The closed set of
+ * built-in types is drawn without virtual calls, Button and Node containers
+ * get no command, and any other element falls back to its virtual render().
+ * @note Static dispatch is chosen by the exact dynamic type, so subclasses
+ * of built-in types keep their render() overrides.
+ * */
+class DisplayList {
+ private:
+  std::vector<DrawCommand> _commands;
+  std::unordered_map<AbstractUIElement*, uint32_t> _index;
+  bool _dirty{true};
+
+  void compile(AbstractUIElement* element);
+  static DrawCommand command(AbstractUIElement* element);
+
+ public:
+  /** @brief Marks the list for a rebuild on the next compile(). */
+  void invalidate() { _dirty = true; }
+
+  /** @brief Returns true if the list needs a rebuild. */
+  bool dirty() const { return _dirty; }
+
+  /** @brief Rebuilds the list from a z-ordered hierarchy if it is dirty. */
+  void compile(const ZOrder& children);
+
+  /** @brief Updates the command of an element from its current state.
+   * @note Does nothing if the list is dirty or the element has no command.
+   * */
+  void patch(AbstractUIElement* element);
+
+  /** @brief Returns the commands in render order. */
+  std::span<const DrawCommand> commands() const { return _commands; }
+
+  size_t size() const { return _commands.size(); }
+
+  void clear();
+};
+
+DrawCommand DisplayList::command(AbstractUIElement* element) {
+  DrawCommand cmd{.kind = DrawCommand::Kind::Element,
+                  .element = element,
+                  .window = element->window,
+                  .surface = element->surface.get(),
+                  .a = {},
+                  .b = {},
+                  .text = {},
+                  .slot = element->handle.index};
+  // subclasses may override render(), they take the virtual fallback
+  const std::type_info& type = typeid(*element);
+  if (type == typeid(UIBox)) {
+    cmd.kind = DrawCommand::Kind::Box;
+  } else if (type == typeid(UIText)) {
+    auto text = static_cast<UIText*>(element);
+    cmd.kind = DrawCommand::Kind::Text;
+    cmd.a = text->get_text_pos();
+    cmd.text = text->get_label();
+  } else if (type == typeid(UILine)) {
+    auto line = static_cast<UILine*>(element);
+    cmd.kind = DrawCommand::Kind::Line;
+    cmd.a = line->get_pos1();
+    cmd.b = line->get_pos2();
+  } else if (type == typeid(UICurve)) {
+    auto curve = static_cast<UICurve*>(element);
+    cmd.kind = DrawCommand::Kind::Curve;
+    cmd.a = curve->get_pos1();
+    cmd.b = curve->get_pos2();
+  }
+  return cmd;
+}
+
+void DisplayList::compile(AbstractUIElement* element) {
+  for (auto& child : element->composition) {
+    compile(child.get());
+  }
+  // containers draw nothing themselves, skip their virtual render() unless
+  // a subclass may have overridden it
+  const std::type_info& type = typeid(*element);
+  if (type == typeid(UIButton) || type == typeid(UINode))
+    return;
+  _index[element] = static_cast<uint32_t>(_commands.size());
+  _commands.emplace_back(command(element));
+}
+
+void DisplayList::compile(const ZOrder& children) {
+  if (!_dirty)
+    return;
+  _commands.clear();
+  _index.clear();
+  for (auto& child : children) {
+    compile(child.get());
+  }
+  _dirty = false;
+}
+
+void DisplayList::patch(AbstractUIElement* element) {
+  if (_dirty)
+    return;
+  auto it = _index.find(element);
+  if (it == _index.end())
+    return;
+  _commands[it->second] = command(element);
+}
+
+void DisplayList::clear() {
+  _commands.clear();
+  _index.clear();
+  _dirty = true;
+}
+
+/** @brief Clips batches of segments to a viewport with Liang-Barsky.
+ *
+ * Segments are stored as columns, so CPUs with AVX2 clip eight per
+ * instruction, others take the scalar path, chosen at runtime. The result of
+ * a segment is the range of its Bresenham steps, see UILine::trace(), that
+ * may be visible. It errs by a step or so towards visible, the cell writes
+ * clip exactly.
+ * */
+class SegmentClipper {
+ private:
+  std::vector<int32_t> _x1;
+  std::vector<int32_t> _y1;
+  std::vector<int32_t> _x2;
+  std::vector<int32_t> _y2;
+  std::vector<int32_t> _first;
+  std::vector<int32_t> _last;
+
+  void _clip_scalar(size_t begin, float width, float height);
+#if defined(__x86_64__) || defined(__i386__)
+  __attribute__((target("avx2"))) size_t _clip_avx2(float width,
+                                                     float height);
+#endif
+
+ public:
+  /** @brief Returns true if clip() runs the AVX2 kernel on this CPU. */
+  static bool simd();
+
+  /** @brief Removes all segments. */
+  void clear();
+
+  /** @brief Adds a segment, clipped by the next clip(). */
+  void add(Coords pos1, Coords pos2);
+
+  /** @brief Returns the number of segments added. */
+  size_t size() const { return _x1.size(); }
+
+  /** @brief Clips every segment to a viewport of width x height cells. */
+  void clip(int width, int height);
+
+  /** @brief Clips like clip() without the AVX2 kernel, e.g. to compare
+   * both. */
+  void clip_scalar(int width, int height);
+
+  /** @brief Returns the first step of segment i that may be visible. */
+  int first(size_t i) const { return _first[i]; }
+
+  /** @brief Returns the last step of segment i that may be visible, less
+   * than first(i) if none is. */
+  int last(size_t i) const { return _last[i]; }
+};
+
+bool SegmentClipper::simd() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+void SegmentClipper::clear() {
+  _x1.clear();
+  _y1.clear();
+  _x2.clear();
+  _y2.clear();
+}
+
+void SegmentClipper::add(Coords pos1, Coords pos2) {
+  _x1.push_back(pos1.x);
+  _y1.push_back(pos1.y);
+  _x2.push_back(pos2.x);
+  _y2.push_back(pos2.y);
+}
+
+void SegmentClipper::clip(int width, int height) {
+  _first.resize(size());
+  _last.resize(size());
+  size_t done{};
+#if defined(__x86_64__) || defined(__i386__)
+  if (simd())
+    done = _clip_avx2(static_cast<float>(width), static_cast<float>(height));
+#endif
+  _clip_scalar(done, static_cast<float>(width), static_cast<float>(height));
+}
+
+void SegmentClipper::clip_scalar(int width, int height) {
+  _first.resize(size());
+  _last.resize(size());
+  _clip_scalar(0, static_cast<float>(width), static_cast<float>(height));
+}
+
+void SegmentClipper::_clip_scalar(size_t begin, float width, float height) {
+  // mirrors the AVX2 kernel operation by operation, min and max included,
+  // so both give the same ranges
+  auto min = [](float a, float b) { return a < b ? a : b; };
+  auto max = [](float a, float b) { return a > b ? a : b; };
+  for (size_t i = begin; i < size(); i++) {
+    int dx = _x2[i] - _x1[i];
+    int dy = _y2[i] - _y1[i];
+    float steps = static_cast<float>(std::max(std::abs(dx), std::abs(dy)));
+    float x = static_cast<float>(_x1[i]);
+    float y = static_cast<float>(_y1[i]);
+    float inv_x = 1.0f / static_cast<float>(dx);
+    float inv_y = 1.0f / static_cast<float>(dy);
+    float left = (-1.0f - x) * inv_x;
+    float right = (width - x) * inv_x;
+    float top = (-1.0f - y) * inv_y;
+    float bottom = (height - y) * inv_y;
+    float t0 = max(min(left, right), 0.0f);
+    t0 = max(min(top, bottom), t0);
+    float t1 = min(max(left, right), 1.0f);
+    t1 = min(max(top, bottom), t1);
+    if (t0 > t1) {
+      _first[i] = 1;
+      _last[i] = 0;
+      continue;
+    }
+    _first[i] = static_cast<int32_t>(std::floor(t0 * steps)) - 1;
+    _last[i] = static_cast<int32_t>(std::ceil(t1 * steps)) + 1;
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) size_t SegmentClipper::_clip_avx2(
+    float width,
+    float height) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 low = _mm256_set1_ps(-1.0f);
+  const __m256 w = _mm256_set1_ps(width);
+  const __m256 h = _mm256_set1_ps(height);
+  const __m256i margin = _mm256_set1_epi32(1);
+  const __m256i hidden_first = _mm256_set1_epi32(1);
+  const __m256i hidden_last = _mm256_setzero_si256();
+  // lambdas would not inherit the target, so columns are loaded in place
+  const auto* x1s = reinterpret_cast<const __m256i*>(_x1.data());
+  const auto* y1s = reinterpret_cast<const __m256i*>(_y1.data());
+  const auto* x2s = reinterpret_cast<const __m256i*>(_x2.data());
+  const auto* y2s = reinterpret_cast<const __m256i*>(_y2.data());
+  auto* firsts = reinterpret_cast<__m256i*>(_first.data());
+  auto* lasts = reinterpret_cast<__m256i*>(_last.data());
+  size_t i{};
+  for (; i + 8 <= size(); i += 8) {
+    __m256i x1 = _mm256_loadu_si256(x1s + i / 8);
+    __m256i y1 = _mm256_loadu_si256(y1s + i / 8);
+    __m256i dxi = _mm256_sub_epi32(_mm256_loadu_si256(x2s + i / 8), x1);
+    __m256i dyi = _mm256_sub_epi32(_mm256_loadu_si256(y2s + i / 8), y1);
+    __m256 steps = _mm256_cvtepi32_ps(
+        _mm256_max_epi32(_mm256_abs_epi32(dxi), _mm256_abs_epi32(dyi)));
+    __m256 x = _mm256_cvtepi32_ps(x1);
+    __m256 y = _mm256_cvtepi32_ps(y1);
+    __m256 inv_x = _mm256_div_ps(one, _mm256_cvtepi32_ps(dxi));
+    __m256 inv_y = _mm256_div_ps(one, _mm256_cvtepi32_ps(dyi));
+    __m256 left = _mm256_mul_ps(_mm256_sub_ps(low, x), inv_x);
+    __m256 right = _mm256_mul_ps(_mm256_sub_ps(w, x), inv_x);
+    __m256 top = _mm256_mul_ps(_mm256_sub_ps(low, y), inv_y);
+    __m256 bottom = _mm256_mul_ps(_mm256_sub_ps(h, y), inv_y);
+    // min and max return the second operand if either is NaN, the ratio of
+    // a segment on a boundary of its parallel axis, so the bounds carried
+    // in the second operand stay numbers
+    __m256 t0 = _mm256_max_ps(_mm256_min_ps(left, right), zero);
+    t0 = _mm256_max_ps(_mm256_min_ps(top, bottom), t0);
+    __m256 t1 = _mm256_min_ps(_mm256_max_ps(left, right), one);
+    t1 = _mm256_min_ps(_mm256_max_ps(top, bottom), t1);
+    __m256i hidden = _mm256_castps_si256(_mm256_cmp_ps(t0, t1, _CMP_GT_OQ));
+
+    __m256i first = _mm256_sub_epi32(
+        _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(t0, steps))),
+        margin);
+    __m256i last = _mm256_add_epi32(
+        _mm256_cvttps_epi32(_mm256_ceil_ps(_mm256_mul_ps(t1, steps))), margin);
+    _mm256_storeu_si256(firsts + i / 8,
+                        _mm256_blendv_epi8(first, hidden_first, hidden));
+    _mm256_storeu_si256(lasts + i / 8,
+                        _mm256_blendv_epi8(last, hidden_last, hidden));
+  }
+  return i;
+}
+#endif
+
+/** @brief Row-major cell buffer that lines are rasterized into in a batch.
+ *
+ * Lines are plotted into the buffer, then every touched row is written to
+ * the target window with one call per run of cells, instead of each line
+ * writing its own cells.
+ * */
+class EdgeRaster {
+ private:
+  int _width{};
+  int _height{};
+  /** Glyph per cell, 0 if untouched. */
+  std::vector<chtype> _cells;
+  /** Touched column range per row, empty if lo > hi. */
+  std::vector<std::pair<int, int>> _rows;
+  size_t _plotted{};
+
+ public:
+  /** @brief Sets the viewport, dropping pending cells if it changed. */
+  void resize(int width, int height);
+
+  /** @brief Plots steps first to last of a line, clipped to the viewport.
+   * @note See SegmentClipper for the steps that may be visible.
+   * */
+  void plot(Coords pos1, Coords pos2, int first, int last);
+
+  /** @brief Writes touched cells to a window row by row and clears them.
+   * @return Number of cells written.
+   * */
+  size_t flush(WINDOW* target);
+
+  /** @brief Returns the number of cells plotted since the last flush. */
+  size_t plotted() const { return _plotted; }
+};
+
+void EdgeRaster::resize(int width, int height) {
+  width = std::max(width, 0);
+  height = std::max(height, 0);
+  if (width == _width && height == _height)
+    return;
+  _width = width;
+  _height = height;
+  _cells.assign(static_cast<size_t>(width) * height, 0);
+  _rows.assign(height, {width, -1});
+  _plotted = 0;
+}
+
+void EdgeRaster::plot(Coords pos1, Coords pos2, int first, int last) {
+  UILine::trace(pos1, pos2, first, last, [this](int x, int y, chtype glyph) {
+    if (x < 0 || x >= _width || y < 0 || y >= _height)
+      return;
+    _cells[static_cast<size_t>(y) * _width + x] = glyph;
+    auto& [lo, hi] = _rows[y];
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+    _plotted++;
+  });
+}
+
+size_t EdgeRaster::flush(WINDOW* target) {
+  size_t written{};
+  for (int y{}; y < _height; y++) {
+    auto& [lo, hi] = _rows[y];
+    if (lo > hi)
+      continue;
+    chtype* row = &_cells[static_cast<size_t>(y) * _width];
+    for (int x = lo; x <= hi;) {
+      if (!row[x]) {
+        x++;
+        continue;
+      }
+      int end = x;
+      while (end <= hi && row[end]) {
+        end++;
+      }
+      mvwaddchnstr(target, y, x, row + x, end - x);
+      written += end - x;
+      std::fill(row + x, row + end, 0);
+      x = end;
+    }
+    lo = _width;
+    hi = -1;
+  }
+  _plotted = 0;
+  return written;
+}
+
+/** @brief Cache of rasterized edges, relative to the cell they start in.
+ *
+ * An entry stays valid while the offset between the ends of its edge holds,
+ * so an edge that was only panned reuses its cells translated. Cells are
+ * stored unclipped, the canvas clips them while drawing.
+ * */
+class EdgeCache {
+ public:
+  /** @brief Cell of a rasterized edge, as offset from the start cell and the
+   * Braille dots set there. */
+  struct Cell {
+    int16_t x;
+    int16_t y;
+    uint8_t mask;
+  };
+
+  /** Renders an unused entry is kept for. */
+  static constexpr uint64_t max_age = 600;
+
+ private:
+  struct Entry {
+    Coords delta;
+    uint64_t used;
+    std::vector<Cell> cells;
+  };
+
+  std::unordered_map<const void*, Entry> _entries;
+  uint64_t _frame{};
+  size_t _hits{};
+  size_t _misses{};
+
+ public:
+  /** @brief Returns the cells of an edge, rasterizing it on a miss.
+   * @param key Edge element.
+   * @param rasterize Called as rasterize(delta, cells) to fill cells with
+   * the edge from (0, 0) to delta.
+   * */
+  template <typename F>
+  std::span<const Cell> get(const void* key,
+                            Coords pos1,
+                            Coords pos2,
+                            F&& rasterize);
+
+  /** @brief Starts a new render, dropping entries unused for max_age. */
+  void age();
+
+  /** @brief Sorts cells by row and ORs the masks of repeated cells. */
+  static void merge(std::vector<Cell>& cells);
+
+  /** @brief Returns the number of cached edges. */
+  size_t size() const { return _entries.size(); }
+
+  /** @brief Returns how many lookups reused or rasterized an edge. */
+  size_t hits() const { return _hits; }
+  size_t misses() const { return _misses; }
+};
+
+template <typename F>
+std::span<const EdgeCache::Cell> EdgeCache::get(const void* key,
+                                                Coords pos1,
+                                                Coords pos2,
+                                                F&& rasterize) {
+  Coords delta{pos2.x - pos1.x, pos2.y - pos1.y};
+  auto [it, added] = _entries.try_emplace(key);
+  Entry& entry = it->second;
+  entry.used = _frame;
+  if (!added && entry.delta.x == delta.x && entry.delta.y == delta.y) {
+    _hits++;
+    return entry.cells;
+  }
+  _misses++;
+  entry.delta = delta;
+  entry.cells.clear();
+  rasterize(delta, entry.cells);
+  return entry.cells;
+}
+
+void EdgeCache::age() {
+  // sweeping is rare, an entry outlives its edge by a few hundred renders
+  if (++_frame % 64)
+    return;
+  std::erase_if(_entries, [this](const auto& entry) {
+    return _frame - entry.second.used > max_age;
+  });
+}
+
+void EdgeCache::merge(std::vector<Cell>& cells) {
+  std::ranges::sort(cells, [](const Cell& a, const Cell& b) {
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+  });
+  size_t out{};
+  for (size_t i{}; i < cells.size(); i++) {
+    if (out > 0 && cells[out - 1].x == cells[i].x &&
+        cells[out - 1].y == cells[i].y)
+      cells[out - 1].mask |= cells[i].mask;
+    else
+      cells[out++] = cells[i];
+  }
+  cells.resize(out);
+}
+
+/** @brief Canvas of 2x4 sub-cell dots drawn as Unicode Braille glyphs.
+ *
+ * Each cell holds an 8 bit mask, one bit per Braille dot, so overlapping
+ * edges composite with a bitwise OR. Lines and curves are rasterized in dot
+ * space at twice the horizontal and four times the vertical resolution of
+ * the screen.
+ * @note Needs the wide character ncursesw and a UTF-8 locale.
+ * */
+class BrailleCanvas {
+ private:
+  int _width{};
+  int _height{};
+  /** Dot mask per cell, bit layout of U+2800. */
+  std::vector<uint8_t> _cells;
+  /** Masks written by the previous flush, to blank cells that emptied. */
+  std::vector<uint8_t> _shown;
+
+  /** Bit of dot (x % 2, y % 4) in a Braille cell. */
+  static constexpr uint8_t _bits[4][2] = {
+      {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+ public:
+  /** @brief Returns the dot at the center of a cell. */
+  static constexpr Coords to_dots(Coords cell) {
+    return Coords{cell.x * 2, cell.y * 4 + 1};
+  }
+
+  /** @brief Sets the canvas size in cells, clearing it if it changed. */
+  void resize(int width, int height);
+
+  /** @brief Clears all dots, the next flush blanks the cells they covered. */
+  void clear() { std::ranges::fill(_cells, 0); }
+
+  /** @brief Sets one dot, ignoring dots outside the canvas. */
+  void dot(int x, int y) {
+    if (x < 0 || y < 0 || x >= _width * 2 || y >= _height * 4)
+      return;
+    _cells[static_cast<size_t>(y >> 2) * _width + (x >> 1)] |=
+        _bits[y & 3][x & 1];
+  }
+
+  /** @brief Draws a line between two dots. */
+  void line(Coords pos1, Coords pos2);
+
+  /** @brief Draws a UICurve between two dots. */
+  void curve(Coords pos1, Coords pos2);
+
+  /** @brief ORs cached masks of an edge starting in cell origin into the
+   * canvas. */
+  void blit(Coords origin, std::span<const EdgeCache::Cell> cells);
+
+  /** @brief Rasterizes a UICurve between the centers of cell (0, 0) and cell
+   * delta for EdgeCache. */
+  static void curve_cells(Coords delta, std::vector<EdgeCache::Cell>& out);
+
+  /** @brief Writes every non-empty cell to a window and blanks cells emptied
+   * since the last flush.
+   * @return Number of cells written.
+   * */
+  size_t flush(WINDOW* target);
+};
+
+void BrailleCanvas::resize(int width, int height) {
+  width = std::max(width, 0);
+  height = std::max(height, 0);
+  if (width == _width && height == _height)
+    return;
+  _width = width;
+  _height = height;
+  _cells.assign(static_cast<size_t>(width) * height, 0);
+  _shown.assign(_cells.size(), 0);
+}
+
+void BrailleCanvas::line(Coords pos1, Coords pos2) {
+  int w = _width * 2;
+  int h = _height * 4;
+  if (std::max(pos1.x, pos2.x) < 0 || std::min(pos1.x, pos2.x) >= w ||
+      std::max(pos1.y, pos2.y) < 0 || std::min(pos1.y, pos2.y) >= h)
+    return;
+  // dots are cells of a line in dot coordinates, the glyph is unused
+  UILine::trace(pos1, pos2, [this](int x, int y, chtype) { dot(x, y); });
+}
+
+void BrailleCanvas::curve(Coords pos1, Coords pos2) {
+  thread_local std::vector<Coords> points;
+  UICurve::flatten(pos1, pos2, points);
+  for (size_t i = 1; i < points.size(); i++) {
+    line(points[i - 1], points[i]);
+  }
+}
+
+void BrailleCanvas::blit(Coords origin,
+                         std::span<const EdgeCache::Cell> cells) {
+  for (const EdgeCache::Cell& cell : cells) {
+    int x = origin.x + cell.x;
+    int y = origin.y + cell.y;
+    if (x < 0 || x >= _width || y < 0 || y >= _height)
+      continue;
+    _cells[static_cast<size_t>(y) * _width + x] |= cell.mask;
+  }
+}
+
+void BrailleCanvas::curve_cells(Coords delta,
+                                std::vector<EdgeCache::Cell>& out) {
+  // flattened away from negative coordinates, where rounding halves differ,
+  // so the cached curve matches one drawn at any on-screen position
+  constexpr int bias = 1 << 12;
+  auto dot = [&out](int x, int y, chtype) {
+    out.emplace_back(EdgeCache::Cell{static_cast<int16_t>((x >> 1) - bias),
+                                     static_cast<int16_t>((y >> 2) - bias),
+                                     _bits[y & 3][x & 1]});
+  };
+  Coords pos1 = to_dots({bias, bias});
+  Coords pos2 = to_dots({bias + delta.x, bias + delta.y});
+  thread_local std::vector<Coords> points;
+  UICurve::flatten(pos1, pos2, points);
+  for (size_t i = 1; i < points.size(); i++) {
+    UILine::trace(points[i - 1], points[i], dot);
+  }
+  EdgeCache::merge(out);
+}
+
+size_t BrailleCanvas::flush(WINDOW* target) {
+  constexpr int run_max = 256;
+  cchar_t run[run_max];
+  size_t written{};
+  for (int y{}; y < _height; y++) {
+    const uint8_t* row = &_cells[static_cast<size_t>(y) * _width];
+    uint8_t* shown = &_shown[static_cast<size_t>(y) * _width];
+    for (int x{}; x < _width;) {
+      if (!row[x]) {
+        if (shown[x])
+          mvwaddch(target, y, x, ' ');
+        shown[x] = 0;
+        x++;
+        continue;
+      }
+      int start = x;
+      int len{};
+      while (x < _width && row[x] && len < run_max) {
+        wchar_t glyph[2] = {static_cast<wchar_t>(0x2800 + row[x]), L'\0'};
+        setcchar(&run[len++], glyph, A_NORMAL, 0, nullptr);
+        shown[x] = row[x];
+        x++;
+      }
+      mvwadd_wchnstr(target, y, start, run, len);
+      written += len;
+    }
+  }
+  return written;
+}
+
+/** @brief How Renderer draws lines and curves on stdscr. */
+enum class EdgeStyle {
+  /** Line characters, curves drawn by UICurve. */
+  Lines,
+  /** Dots of a BrailleCanvas. */
+  Braille,
+  /** Orthogonal routes of box drawing characters, see JunctionCanvas. */
+  Orthogonal,
+  /** Orthogonal routes around boxes, see EdgeRouter. */
+  Routed,
+  /** Bundles of dense edges as Braille dots, see EdgeBundler. */
+  Bundled,
+};
+
+/** @brief Canvas of orthogonal edges drawn with box drawing characters.
+ *
+ * Each cell holds a 4 bit mask of the directions edges leave it in. Edges
+ * sharing a cell OR their masks, so corners, T-junctions and crossings merge
+ * into one glyph found by a table lookup.
+ * */
+class JunctionCanvas {
+ private:
+  int _width{};
+  int _height{};
+  std::vector<uint8_t> _cells;
+  /** Masks written by the previous flush, to blank cells that emptied. */
+  std::vector<uint8_t> _shown;
+
+  enum : uint8_t { Up = 1, Right = 2, Down = 4, Left = 8 };
+
+  /** ACS character per direction mask, 0 for none. */
+  static constexpr char _glyphs[16] = {
+      0,   'x', 'q', 'm', 'x', 'x', 'l', 't',
+      'q', 'j', 'q', 'v', 'k', 'u', 'w', 'n'};
+
+  void _horizontal(int y, int x1, int x2);
+  void _vertical(int x, int y1, int y2);
+
+ public:
+  /** @brief Sets the canvas size in cells, clearing it if it changed. */
+  void resize(int width, int height);
+
+  /** @brief Clears all edges, the next flush blanks the cells they
+   * covered. */
+  void clear() { std::ranges::fill(_cells, 0); }
+
+  /** @brief Draws an edge between two cells as a horizontal, vertical,
+   * horizontal elbow turning halfway between them. */
+  void route(Coords pos1, Coords pos2) { path(elbow(pos1, pos2)); }
+
+  /** @brief Returns the polyline route() draws between two cells. */
+  static std::array<Coords, 4> elbow(Coords pos1, Coords pos2);
+
+  /** @brief Draws an orthogonal polyline, e.g. a route of EdgeRouter. */
+  void path(std::span<const Coords> points);
+
+  /** @brief Writes every non-empty cell to a window and blanks cells emptied
+   * since the last flush.
+   * @return Number of cells written.
+   * */
+  size_t flush(WINDOW* target);
+};
+
+void JunctionCanvas::resize(int width, int height) {
+  width = std::max(width, 0);
+  height = std::max(height, 0);
+  if (width == _width && height == _height)
+    return;
+  _width = width;
+  _height = height;
+  _cells.assign(static_cast<size_t>(width) * height, 0);
+  _shown.assign(_cells.size(), 0);
+}
+
+void JunctionCanvas::_horizontal(int y, int x1, int x2) {
+  int lo = std::min(x1, x2);
+  int hi = std::max(x1, x2);
+  if (y < 0 || y >= _height || lo == hi)
+    return;
+  uint8_t* row = &_cells[static_cast<size_t>(y) * _width];
+  for (int x = std::max(lo, 0); x <= std::min(hi, _width - 1); x++) {
+    row[x] |= (x > lo ? Left : 0) | (x < hi ? Right : 0);
+  }
+}
+
+void JunctionCanvas::_vertical(int x, int y1, int y2) {
+  int lo = std::min(y1, y2);
+  int hi = std::max(y1, y2);
+  if (x < 0 || x >= _width || lo == hi)
+    return;
+  for (int y = std::max(lo, 0); y <= std::min(hi, _height - 1); y++) {
+    _cells[static_cast<size_t>(y) * _width + x] |=
+        (y > lo ? Up : 0) | (y < hi ? Down : 0);
+  }
+}
+
+std::array<Coords, 4> JunctionCanvas::elbow(Coords pos1, Coords pos2) {
+  int mid = (pos1.x + pos2.x) / 2;
+  return {pos1, Coords{mid, pos1.y}, Coords{mid, pos2.y}, pos2};
+}
+
+void JunctionCanvas::path(std::span<const Coords> points) {
+  for (size_t i = 1; i < points.size(); i++) {
+    if (points[i - 1].y == points[i].y)
+      _horizontal(points[i].y, points[i - 1].x, points[i].x);
+    else
+      _vertical(points[i].x, points[i - 1].y, points[i].y);
+  }
+}
+
+size_t JunctionCanvas::flush(WINDOW* target) {
+  constexpr int run_max = 256;
+  chtype run[run_max];
+  size_t written{};
+  for (int y{}; y < _height; y++) {
+    const uint8_t* row = &_cells[static_cast<size_t>(y) * _width];
+    uint8_t* shown = &_shown[static_cast<size_t>(y) * _width];
+    for (int x{}; x < _width;) {
+      if (!row[x]) {
+        if (shown[x])
+          mvwaddch(target, y, x, ' ');
+        shown[x] = 0;
+        x++;
+        continue;
+      }
+      int start = x;
+      int len{};
+      while (x < _width && row[x] && len < run_max) {
+        run[len++] = NCURSES_ACS(_glyphs[row[x]]);
+        shown[x] = row[x];
+        x++;
+      }
+      mvwaddchnstr(target, y, start, run, len);
+      written += len;
+    }
+  }
+  return written;
+}
+
+/** @brief Fixed set of worker threads running parallel loops.
+ * @note The calling thread takes part in every loop, a pool of zero workers
+ * runs loops inline.
+ * */
+class ThreadPool {
+ private:
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  std::function<void(size_t)> _task;
+  size_t _count{};
+  std::atomic<size_t> _next{};
+  /** Workers still running the current loop. */
+  size_t _busy{};
+  uint64_t _generation{};
+  bool _stop{false};
+
+  void _run();
+  void _work();
+
+ public:
+  /** @brief Starts workers, by default one less than the hardware
+   * threads. */
+  explicit ThreadPool(size_t workers = std::max(
+                          std::thread::hardware_concurrency(), 1u) - 1);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /** @brief Returns the number of worker threads. */
+  size_t size() const { return _workers.size(); }
+
+  /** @brief Calls f(i) for every i below count across all threads and
+   * returns once all calls have finished.
+   * @note Not reentrant.
+   * */
+  void parallel_for(size_t count, std::function<void(size_t)> f);
+};
+
+ThreadPool::ThreadPool(size_t workers) {
+  for (size_t i{}; i < workers; i++) {
+    _workers.emplace_back([this]() { _run(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::_work() {
+  for (size_t i = _next++; i < _count; i = _next++) {
+    _task(i);
+  }
+}
+
+void ThreadPool::_run() {
+  uint64_t seen{};
+  while (true) {
+    {
+      std::unique_lock lock(_mutex);
+      _wake.wait(lock, [&]() { return _stop || _generation != seen; });
+      if (_stop)
+        return;
+      seen = _generation;
+    }
+    _work();
+    std::lock_guard lock(_mutex);
+    if (--_busy == 0)
+      _done.notify_all();
+  }
+}
+
+void ThreadPool::parallel_for(size_t count, std::function<void(size_t)> f) {
+  if (count == 0)
+    return;
+  if (_workers.empty() || count == 1) {
+    for (size_t i{}; i < count; i++) {
+      f(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard lock(_mutex);
+    _task = std::move(f);
+    _count = count;
+    _next = 0;
+    _busy = _workers.size();
+    _generation++;
+  }
+  _wake.notify_all();
+  _work();
+  // every worker checks in, so none is still reading this loop's task when
+  // the next one starts
+  std::unique_lock lock(_mutex);
+  _done.wait(lock, [&]() { return _busy == 0; });
+  _task = nullptr;
+}
+
+/** @brief Routes edges orthogonally around boxes with A*.
+ *
+ * Boxes are rasterized into an obstacle map of box ids, kept across frames
+ * and repainted only where boxes appeared, moved or vanished. Each edge is
+ * routed from cell to cell, allowed to cross only the boxes its ends lie in,
+ * and bends cost extra so routes stay straight. Routes are cached per edge and
+ * reused until an end moves or the obstacle map changes under the route's
+ * bounding box; the remaining edges are routed in parallel.
+ * */
+class EdgeRouter {
+ public:
+  /** @brief Edge to route, identified by its element. */
+  struct Edge {
+    const void* key;
+    Coords pos1;
+    Coords pos2;
+  };
+
+  /** Cost of a bend, in cells of straight route. */
+  static constexpr int bend_cost = 3;
+  /** Fewest dirty edges worth waking the thread pool for. */
+  static constexpr size_t parallel_min = 8;
+
+ private:
+  struct Route {
+    Coords pos1;
+    Coords pos2;
+    /** Ends and bends of the route, pos1 first. */
+    std::vector<Coords> points;
+    Bounds bounds;
+    uint64_t frame;
+  };
+
+  struct Obstacle {
+    /** Element of the box, null for a free id. */
+    const void* key;
+    Bounds bounds;
+    /** Obstacle map the box was last added to. */
+    uint64_t seen;
+  };
+
+  int _width{};
+  int _height{};
+  /** Box id per cell, 0 if free. Ids index _boxes, starting at 1. */
+  std::vector<uint32_t> _obstacles;
+  std::vector<Obstacle> _boxes;
+  std::vector<uint32_t> _free_ids;
+  std::unordered_map<const void*, uint32_t> _ids;
+  /** Areas to repaint on end_obstacles(). */
+  std::vector<Bounds> _dirty_areas;
+  /** Cells of an area before repainting it. */
+  std::vector<uint32_t> _scratch;
+  uint64_t _map{};
+  /** Box cells added or removed since the last update, as a rectangle. */
+  Bounds _changed{};
+  bool _has_changed{false};
+  uint64_t _frame{};
+  std::unordered_map<const void*, Route> _routes;
+  std::vector<Route*> _dirty;
+  std::unique_ptr<ThreadPool> _pool;
+  size_t _routed{};
+
+  uint32_t _at(Coords c) const {
+    return _obstacles[static_cast<size_t>(c.y) * _width + c.x];
+  }
+  bool _inside(Coords c) const {
+    return c.x >= 0 && c.y >= 0 && c.x < _width && c.y < _height;
+  }
+  void _route(Route& route) const;
+  void _repaint(Bounds area);
+
+ public:
+  /** @brief Starts collecting the boxes of a new obstacle map of the given
+   * size in cells.
+   * @note A new size repaints the whole map.
+   * */
+  void begin_obstacles(int width, int height);
+
+  /** @brief Adds a box to the obstacle map, or moves it.
+   * @param key Element of the box, identifying it across maps.
+   * */
+  void add_obstacle(const void* key, Bounds bounds);
+
+  /** @brief Drops the boxes not added since begin_obstacles() and repaints
+   * the areas boxes entered or left.
+   * @return True if any cell became blocked or free since the last map.
+   * */
+  bool end_obstacles();
+
+  /** @brief Routes all edges, reusing cached routes that are still valid.
+   * @note Routes of edges not passed are dropped.
+   * */
+  void update(std::span<const Edge> edges);
+
+  /** @brief Returns the route of an edge from the last update, empty if
+   * unknown. */
+  std::span<const Coords> path(const void* key) const;
+
+  /** @brief Returns the number of edges routed by the last update, the rest
+   * reused their route. */
+  size_t routed() const { return _routed; }
+};
+
+void EdgeRouter::begin_obstacles(int width, int height) {
+  width = std::max(width, 0);
+  height = std::max(height, 0);
+  _map++;
+  if (width != _width || height != _height) {
+    _width = width;
+    _height = height;
+    _obstacles.assign(static_cast<size_t>(width) * height, 0);
+    _dirty_areas.assign(1, Bounds{0, 0, width, height});
+    // every route may leave the screen, start over
+    _routes.clear();
+  }
+}
+
+void EdgeRouter::add_obstacle(const void* key, Bounds b) {
+  auto [it, added] = _ids.try_emplace(key, 0);
+  if (added) {
+    if (_free_ids.empty()) {
+      _boxes.emplace_back();
+      it->second = static_cast<uint32_t>(_boxes.size());
+    } else {
+      it->second = _free_ids.back();
+      _free_ids.pop_back();
+    }
+    _boxes[it->second - 1] = Obstacle{.key = key, .bounds = b, .seen = _map};
+    _dirty_areas.emplace_back(b);
+    return;
+  }
+  Obstacle& box = _boxes[it->second - 1];
+  box.seen = _map;
+  const Bounds& old = box.bounds;
+  if (old.x == b.x && old.y == b.y && old.width == b.width &&
+      old.height == b.height)
+    return;
+  _dirty_areas.emplace_back(old);
+  _dirty_areas.emplace_back(b);
+  box.bounds = b;
+}
+
+void EdgeRouter::_repaint(Bounds area) {
+  int x1 = std::max(area.x, 0);
+  int x2 = std::min(area.x + area.width, _width);
+  int y1 = std::max(area.y, 0);
+  int y2 = std::min(area.y + area.height, _height);
+  if (x1 >= x2 || y1 >= y2)
+    return;
+  size_t w = x2 - x1;
+  _scratch.resize(w * (y2 - y1));
+  for (int y = y1; y < y2; y++) {
+    uint32_t* row = &_obstacles[static_cast<size_t>(y) * _width + x1];
+    std::copy_n(row, w, &_scratch[(y - y1) * w]);
+    std::fill_n(row, w, 0);
+  }
+  // in id order, so overlapping boxes resolve the same in every area
+  for (uint32_t id = 1; id <= _boxes.size(); id++) {
+    const Obstacle& box = _boxes[id - 1];
+    if (!box.key)
+      continue;
+    int bx1 = std::max(box.bounds.x, x1);
+    int bx2 = std::min(box.bounds.x + box.bounds.width, x2);
+    int by2 = std::min(box.bounds.y + box.bounds.height, y2);
+    if (bx1 >= bx2)
+      continue;
+    for (int y = std::max(box.bounds.y, y1); y < by2; y++) {
+      std::fill_n(&_obstacles[static_cast<size_t>(y) * _width + bx1],
+                  bx2 - bx1, id);
+    }
+  }
+
+  // only blocked versus free matters to a route
+  int cx1{x2}, cy1{y2}, cx2{-1}, cy2{-1};
+  for (int y = y1; y < y2; y++) {
+    const uint32_t* row = &_obstacles[static_cast<size_t>(y) * _width];
+    const uint32_t* old = &_scratch[(y - y1) * w];
+    for (int x = x1; x < x2; x++) {
+      if (!row[x] == !old[x - x1])
+        continue;
+      cx1 = std::min(cx1, x);
+      cx2 = std::max(cx2, x);
+      cy1 = std::min(cy1, y);
+      cy2 = std::max(cy2, y);
+    }
+  }
+  if (cx2 < 0)
+    return;
+  if (_has_changed) {
+    cx1 = std::min(cx1, _changed.x);
+    cy1 = std::min(cy1, _changed.y);
+    cx2 = std::max(cx2, _changed.x + _changed.width - 1);
+    cy2 = std::max(cy2, _changed.y + _changed.height - 1);
+  }
+  _changed = Bounds{cx1, cy1, cx2 - cx1 + 1, cy2 - cy1 + 1};
+  _has_changed = true;
+}
+
+bool EdgeRouter::end_obstacles() {
+  for (auto it = _ids.begin(); it != _ids.end();) {
+    Obstacle& box = _boxes[it->second - 1];
+    if (box.seen == _map) {
+      ++it;
+      continue;
+    }
+    _dirty_areas.emplace_back(box.bounds);
+    box.key = nullptr;
+    _free_ids.emplace_back(it->second);
+    it = _ids.erase(it);
+  }
+  _has_changed = false;
+  for (Bounds area : _dirty_areas) {
+    _repaint(area);
+  }
+  _dirty_areas.clear();
+  return _has_changed;
+}
+
+void EdgeRouter::_route(Route& route) const {
+  Coords start = route.pos1;
+  Coords goal = route.pos2;
+  route.points.clear();
+  auto elbow = [&]() {
+    int mid = (start.x + goal.x) / 2;
+    route.points = {start, {mid, start.y}, {mid, goal.y}, goal};
+  };
+  if (!_inside(start) || !_inside(goal)) {
+    elbow();
+    return;
+  }
+
+  // states are cell * 4 + direction of the step into the cell
+  constexpr Coords steps[4] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+  struct Entry {
+    int g;
+    uint32_t state;
+    Coords cell;
+  };
+  // per thread, reused across searches and stamped instead of cleared
+  struct Scratch {
+    std::vector<int> cost;
+    std::vector<uint32_t> from;
+    std::vector<uint32_t> stamp;
+    /** Open states bucketed by estimated total cost. */
+    std::vector<std::vector<Entry>> open;
+    uint32_t search{};
+  };
+  thread_local Scratch scratch;
+  auto& [cost, from, stamp, open, search] = scratch;
+  size_t states = static_cast<size_t>(_width) * _height * 4;
+  if (stamp.size() != states) {
+    cost.assign(states, 0);
+    from.assign(states, 0);
+    stamp.assign(states, 0);
+  }
+  if (++search == 0) {
+    std::ranges::fill(stamp, 0);
+    search = 1;
+  }
+
+  uint32_t start_box = _at(start);
+  uint32_t goal_box = _at(goal);
+  auto blocked = [&](Coords c) {
+    uint32_t id = _at(c);
+    return id && id != start_box && id != goal_box;
+  };
+  // distance plus the fewest bends left when heading in dir, any
+  // direction if dir is -1
+  auto estimate = [&](Coords c, int dir) {
+    int dx = goal.x - c.x;
+    int dy = goal.y - c.y;
+    int toward_x = dx > 0 ? 1 : 3;
+    int toward_y = dy > 0 ? 2 : 0;
+    int bends{};
+    if (dx && dy)
+      bends = dir < 0 || dir == toward_x || dir == toward_y ? 1 : 2;
+    else if (dx || dy)
+      bends = dir < 0 || dir == (dx ? toward_x : toward_y) ? 0
+              : dir == ((dx ? toward_x : toward_y) + 2) % 4 ? 2
+                                                             : 1;
+    return std::abs(dx) + std::abs(dy) + bends * bend_cost;
+  };
+  auto index = [this](Coords c, int dir) {
+    return (static_cast<uint32_t>(c.y) * _width + c.x) * 4 + dir;
+  };
+
+  // costs are small integers, so the open set is a bucket per estimate
+  // instead of a heap. Each bucket pops last in first, which follows one of
+  // many equally good routes to the end instead of widening them all.
+  for (auto& bucket : open) {
+    bucket.clear();
+  }
+  size_t lowest = SIZE_MAX;
+  size_t pending{};
+  auto push = [&](Coords c, int dir, int g, uint32_t parent) {
+    uint32_t state = index(c, dir);
+    if (stamp[state] == search && cost[state] <= g)
+      return;
+    stamp[state] = search;
+    cost[state] = g;
+    from[state] = parent == UINT32_MAX ? state : parent;
+    size_t f = g + estimate(c, parent == UINT32_MAX ? -1 : dir);
+    if (f >= open.size())
+      open.resize(f + 1);
+    open[f].emplace_back(Entry{g, state, c});
+    lowest = std::min(lowest, f);
+    pending++;
+  };
+  for (int dir{}; dir < 4; dir++) {
+    push(start, dir, 0, UINT32_MAX);
+  }
+
+  // ends walled in by boxes would otherwise search the whole screen
+  size_t budget = static_cast<size_t>(_width) * _height;
+  uint32_t found{UINT32_MAX};
+  while (pending > 0 && budget > 0) {
+    while (open[lowest].empty()) {
+      lowest++;
+    }
+    auto [g, state, c] = open[lowest].back();
+    open[lowest].pop_back();
+    pending--;
+    // skip entries superseded by a cheaper route to the same state
+    if (cost[state] != g)
+      continue;
+    if (c.x == goal.x && c.y == goal.y) {
+      found = state;
+      break;
+    }
+    budget--;
+    int dir = static_cast<int>(state % 4);
+    for (int next{}; next < 4; next++) {
+      // never step straight back
+      if ((next + 2) % 4 == dir && state != from[state])
+        continue;
+      Coords n{c.x + steps[next].x, c.y + steps[next].y};
+      if (!_inside(n) || blocked(n))
+        continue;
+      bool bend = next != dir && state != from[state];
+      push(n, next, g + 1 + (bend ? bend_cost : 0), state);
+    }
+  }
+  if (found == UINT32_MAX) {
+    elbow();
+    return;
+  }
+
+  // walk back keeping the cells where the direction changes
+  route.points.emplace_back(goal);
+  uint32_t state = found;
+  while (from[state] != state) {
+    uint32_t parent = from[state];
+    if (parent % 4 != state % 4 && from[parent] != parent)
+      route.points.emplace_back(Coords{static_cast<int>(parent / 4 % _width),
+                                       static_cast<int>(parent / 4 / _width)});
+    state = parent;
+  }
+  route.points.emplace_back(start);
+  std::ranges::reverse(route.points);
+}
+
+void EdgeRouter::update(std::span<const Edge> edges) {
+  _frame++;
+  _dirty.clear();
+  auto overlaps = [](const Bounds& a, const Bounds& b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width &&
+           a.y < b.y + b.height && b.y < a.y + a.height;
+  };
+  for (const Edge& edge : edges) {
+    auto [it, added] = _routes.try_emplace(edge.key);
+    Route& route = it->second;
+    route.frame = _frame;
+    bool moved = route.pos1.x != edge.pos1.x || route.pos1.y != edge.pos1.y ||
+                 route.pos2.x != edge.pos2.x || route.pos2.y != edge.pos2.y;
+    if (!added && !moved &&
+        !(_has_changed && overlaps(route.bounds, _changed)))
+      continue;
+    route.pos1 = edge.pos1;
+    route.pos2 = edge.pos2;
+    _dirty.emplace_back(&route);
+  }
+  std::erase_if(_routes, [this](const auto& entry) {
+    return entry.second.frame != _frame;
+  });
+
+  auto route = [this](size_t i) {
+    Route& r = *_dirty[i];
+    _route(r);
+    int x1{r.pos1.x}, y1{r.pos1.y}, x2{r.pos1.x}, y2{r.pos1.y};
+    for (const Coords& p : r.points) {
+      x1 = std::min(x1, p.x);
+      y1 = std::min(y1, p.y);
+      x2 = std::max(x2, p.x);
+      y2 = std::max(y2, p.y);
+    }
+    // one cell of margin, a box appearing next to a route may open a
+    // shorter one
+    r.bounds = Bounds{x1 - 1, y1 - 1, x2 - x1 + 3, y2 - y1 + 3};
+  };
+  if (_dirty.size() >= parallel_min) {
+    if (!_pool)
+      _pool = std::make_unique<ThreadPool>();
+    _pool->parallel_for(_dirty.size(), route);
+  } else {
+    for (size_t i{}; i < _dirty.size(); i++) {
+      route(i);
+    }
+  }
+  _routed = _dirty.size();
+}
+
+std::span<const Coords> EdgeRouter::path(const void* key) const {
+  auto it = _routes.find(key);
+  if (it == _routes.end())
+    return {};
+  return it->second.points;
+}
+
+/** @brief Bundles dense edges on a background thread.
+ *
+ * The screen is divided into clusters of cluster_width by cluster_height
+ * cells. Edges whose ends fall in the same two clusters form a bundle, drawn
+ * as one trunk between the cluster centers and a short fan from every end to
+ * its center. Edges between the same or neighbouring clusters stay straight.
+ * Cluster centers are fixed, so a moved edge only changes the bundles it
+ * leaves and joins, and only those are rebuilt.
+ * */
+class EdgeBundler {
+ public:
+  /** Size of a cluster in cells, about square on screen. */
+  static constexpr int cluster_width = 8;
+  static constexpr int cluster_height = 4;
+
+  using Segment = std::pair<Coords, Coords>;
+
+  /** @brief Bundled segments for one submitted set of edges. */
+  struct Result {
+    uint64_t version;
+    std::vector<Segment> segments;
+    size_t bundles;
+    size_t edges;
+  };
+
+ private:
+  struct EdgeState {
+    Coords pos1;
+    Coords pos2;
+    uint64_t bundle;
+    /** Position in the member list of its bundle. */
+    size_t slot;
+    uint64_t frame;
+  };
+  struct Bundle {
+    std::vector<const void*> members;
+    std::vector<Segment> segments;
+    bool dirty;
+  };
+
+  // shared with the worker, guarded by _mutex
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _ready;
+  std::vector<EdgeRouter::Edge> _input;
+  uint64_t _submitted{};
+  std::shared_ptr<const Result> _result;
+  bool _stop{false};
+  std::thread _worker;
+
+  // owned by the worker
+  std::unordered_map<const void*, EdgeState> _edges;
+  std::unordered_map<uint64_t, Bundle> _bundles;
+  uint64_t _frame{};
+
+  static Coords _cluster(Coords c) {
+    auto floor_div = [](int a, int b) { return a / b - (a % b < 0); };
+    return Coords{floor_div(c.x, cluster_width),
+                  floor_div(c.y, cluster_height)};
+  }
+  static uint64_t _key(Coords a, Coords b);
+  static Coords _center(Coords cluster) {
+    return Coords{cluster.x * cluster_width + cluster_width / 2,
+                  cluster.y * cluster_height + cluster_height / 2};
+  }
+  void _run();
+  void _update(std::span<const EdgeRouter::Edge> edges);
+  void _rebuild(Bundle& bundle) const;
+
+ public:
+  EdgeBundler() = default;
+  ~EdgeBundler();
+
+  EdgeBundler(const EdgeBundler&) = delete;
+  EdgeBundler& operator=(const EdgeBundler&) = delete;
+
+  /** @brief Hands the current edges to the worker.
+   * @return Version the result for these edges will carry.
+   * */
+  uint64_t submit(std::span<const EdgeRouter::Edge> edges);
+
+  /** @brief Waits until the result of a submitted version is out.
+   * @return True if it is, false on timeout.
+   * */
+  bool wait(uint64_t version, std::chrono::microseconds timeout);
+
+  /** @brief Returns the latest result, null before the first one. */
+  std::shared_ptr<const Result> result();
+};
+
+EdgeBundler::~EdgeBundler() {
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  if (_worker.joinable())
+    _worker.join();
+}
+
+uint64_t EdgeBundler::_key(Coords a, Coords b) {
+  auto pack = [](Coords c) {
+    return static_cast<uint64_t>(static_cast<uint16_t>(c.x)) << 16 |
+           static_cast<uint16_t>(c.y);
+  };
+  // both directions share a bundle
+  uint64_t first = pack(a);
+  uint64_t second = pack(b);
+  if (first > second)
+    std::swap(first, second);
+  return first << 32 | second;
+}
+
+uint64_t EdgeBundler::submit(std::span<const EdgeRouter::Edge> edges) {
+  uint64_t version{};
+  {
+    std::lock_guard lock(_mutex);
+    _input.assign(edges.begin(), edges.end());
+    version = ++_submitted;
+    if (!_worker.joinable())
+      _worker = std::thread([this]() { _run(); });
+  }
+  _wake.notify_one();
+  return version;
+}
+
+bool EdgeBundler::wait(uint64_t version, std::chrono::microseconds timeout) {
+  std::unique_lock lock(_mutex);
+  return _ready.wait_for(lock, timeout, [&]() {
+    return _result && _result->version >= version;
+  });
+}
+
+std::shared_ptr<const EdgeBundler::Result> EdgeBundler::result() {
+  std::lock_guard lock(_mutex);
+  return _result;
+}
+
+void EdgeBundler::_run() {
+  uint64_t done{};
+  std::vector<EdgeRouter::Edge> edges;
+  while (true) {
+    {
+      std::unique_lock lock(_mutex);
+      _wake.wait(lock, [&]() { return _stop || _submitted != done; });
+      if (_stop)
+        return;
+      // only the latest edges matter, older submissions are skipped
+      edges.swap(_input);
+      done = _submitted;
+    }
+    _update(edges);
+
+    auto result = std::make_shared<Result>();
+    result->version = done;
+    result->bundles = _bundles.size();
+    result->edges = _edges.size();
+    for (const auto& [key, bundle] : _bundles) {
+      result->segments.insert(result->segments.end(), bundle.segments.begin(),
+                              bundle.segments.end());
+    }
+    {
+      std::lock_guard lock(_mutex);
+      _result = std::move(result);
+    }
+    _ready.notify_all();
+  }
+}
+
+void EdgeBundler::_update(std::span<const EdgeRouter::Edge> edges) {
+  _frame++;
+  auto leave = [this](EdgeState& state) {
+    Bundle& bundle = _bundles[state.bundle];
+    // swap remove, moving the last member into the freed slot
+    const void* last = bundle.members.back();
+    bundle.members[state.slot] = last;
+    _edges[last].slot = state.slot;
+    bundle.members.pop_back();
+    bundle.dirty = true;
+  };
+  auto join = [this](const void* key, EdgeState& state) {
+    state.bundle = _key(_cluster(state.pos1), _cluster(state.pos2));
+    Bundle& bundle = _bundles[state.bundle];
+    state.slot = bundle.members.size();
+    bundle.members.emplace_back(key);
+    bundle.dirty = true;
+  };
+
+  for (const EdgeRouter::Edge& edge : edges) {
+    auto [it, added] = _edges.try_emplace(edge.key);
+    EdgeState& state = it->second;
+    state.frame = _frame;
+    if (!added && state.pos1.x == edge.pos1.x && state.pos1.y == edge.pos1.y &&
+        state.pos2.x == edge.pos2.x && state.pos2.y == edge.pos2.y)
+      continue;
+    if (!added)
+      leave(state);
+    state.pos1 = edge.pos1;
+    state.pos2 = edge.pos2;
+    join(edge.key, state);
+  }
+  for (auto it = _edges.begin(); it != _edges.end();) {
+    if (it->second.frame == _frame) {
+      ++it;
+      continue;
+    }
+    leave(it->second);
+    it = _edges.erase(it);
+  }
+
+  for (auto it = _bundles.begin(); it != _bundles.end();) {
+    Bundle& bundle = it->second;
+    if (bundle.members.empty()) {
+      it = _bundles.erase(it);
+      continue;
+    }
+    if (bundle.dirty)
+      _rebuild(bundle);
+    ++it;
+  }
+}
+
+void EdgeBundler::_rebuild(Bundle& bundle) const {
+  bundle.dirty = false;
+  bundle.segments.clear();
+  const EdgeState& first = _edges.at(bundle.members.front());
+  Coords a = _cluster(first.pos1);
+  Coords b = _cluster(first.pos2);
+  bool near = std::abs(a.x - b.x) <= 1 && std::abs(a.y - b.y) <= 1;
+  if (near || bundle.members.size() == 1) {
+    for (const void* member : bundle.members) {
+      const EdgeState& state = _edges.at(member);
+      bundle.segments.emplace_back(state.pos1, state.pos2);
+    }
+  } else {
+    bundle.segments.emplace_back(_center(a), _center(b));
+    for (const void* member : bundle.members) {
+      const EdgeState& state = _edges.at(member);
+      // members may run either way between the two clusters
+      Coords from = _cluster(state.pos1);
+      bool forward = from.x == a.x && from.y == a.y;
+      bundle.segments.emplace_back(state.pos1, _center(forward ? a : b));
+      bundle.segments.emplace_back(state.pos2, _center(forward ? b : a));
+    }
+  }
+  // edges from the same nodes share their fans
+  auto order = [](const Segment& s) {
+    return std::tuple(s.first.x, s.first.y, s.second.x, s.second.y);
+  };
+  std::ranges::sort(bundle.segments, {}, order);
+  auto same = [&order](const Segment& l, const Segment& r) {
+    return order(l) == order(r);
+  };
+  auto [begin, end] = std::ranges::unique(bundle.segments, same);
+  bundle.segments.erase(begin, end);
+}
+
+/** @brief RAII wrapper for ncurses screen context with UI element hierarchy
+ * and event management
+ *
+ * Initializes ncurses with mouse support, manages screen dimensions, and owns
+ * a tree of UI elements.
+ *
+ * Handles lifecycle (initscr/endwin), resize events, and event dispatching
+ * via Event::Observer.
+ *
+ * @note Non-copyable/moveable to ensure exclusive ownership of ncurses state.
+ * */
+class ScreenContext : public SceneListener {
+ private:
+  WINDOW* _window;
+  mmask_t _oldmask;
+  int _screen_width;
+  int _screen_height;
+  bool _running;
+  Event::Observer _observer;
+  PanelRegistry _panels;
+  uint64_t _version{};
+
+  struct HitCache {
+    int x{-1};
+    int y{-1};
+    uint64_t version{};
+    bool valid{false};
+    std::weak_ptr<AbstractUIElement> element;
+    AbstractUIElement* root{nullptr};
+  };
+  HitCache _hit_cache;
+  size_t _hit_cache_hits{};
+  size_t _hit_cache_misses{};
+  ZOrder _children;
+  std::vector<std::shared_ptr<AbstractUIElement>> _hit_children;
+  SegmentIndex _edges;
+  ElementStore _store;
+  std::vector<uint8_t> _visible;
+  bool _order_dirty{false};
+  ElementResources _resources;
+  DisplayList _display;
+
+  /** Nesting depth of begin_update() calls. */
+  int _update_depth{};
+  /** Children added during an update, sorted on commit. */
+  std::vector<AbstractUIElement*> _pending_sort;
+  /** Elements moved or lines attached during an update. */
+  std::unordered_set<AbstractUIElement*> _pending_moves;
+  bool _pending_panels{false};
+  SnapshotWriter _snapshots;
+  bool _snapshots_enabled{false};
+
+  void configure_ncurses();
+  void cleanup_ncurses();
+
+  /** @brief Attaches an element hierarchy to this context so geometry
+   * changes are tracked.
+   * @param parent Handle of the parent element, invalid for top level.
+   * */
+  void attach(AbstractUIElement* element, Handle parent = {});
+
+  /** @brief Writes an element's state through to the store, along with
+   * composition elements sharing its window. */
+  void refresh(AbstractUIElement* element);
+
+  /** @brief Recomputes the hit order of every slot after structural
+   * changes. */
+  void refresh_order();
+  void refresh_order(AbstractUIElement* element, uint32_t& rank);
+
+  /** @brief Detaches an element hierarchy from this context. */
+  void detach(AbstractUIElement* element);
+
+  /** @brief Writes a moved element through to the store, display list and
+   * edge index. */
+  void apply_move(AbstractUIElement* element);
+
+  /** @brief Returns true for lines and curves, which are hit tested and
+   * damaged through the edge index rather than their bounds. */
+  static bool is_edge(AbstractUIElement* element);
+
+  /** @brief Writes the geometry of a line or curve to the edge index.
+   * @return True if the indexed geometry changed.
+   * */
+  bool index_edge(AbstractUIElement* element);
+
+  /** @brief Marks a line or curve to be redrawn on the next render. */
+  static void damage_edge(AbstractUIElement* element);
+
+  /** @brief Applies everything deferred by an update in one pass. */
+  void reconcile();
+
+  /** @brief Writes a slot through to the snapshot head if snapshots are
+   * enabled. */
+  void record(Handle h);
+
+ public:
+  ScreenContext();
+  ~ScreenContext();
+
+  /** Disallows move/copy semantics */
+  ScreenContext(const ScreenContext&) = delete;
+  ScreenContext& operator=(const ScreenContext&) = delete;
+  ScreenContext(ScreenContext&&) = delete;
+  ScreenContext& operator=(ScreenContext&&) = delete;
+
+  /** @brief Returns the current screen width in characters.
+   * @return Cached width from last ncurses query.
+   */
+  int get_width() const { return _screen_width; }
+
+  /** @brief Returns the current screen height in characters.
+   * @return Cached height from last ncurses query.
+   */
+  int get_height() const { return _screen_height; }
+
+  /**
+   * @brief Returns the raw ncurses window handle.
+   * @return Pointer to underlying WINDOW (do not delete).
+   * @warning Direct ncurses usage bypasses RAII safety.
+   */
+  WINDOW* get_window() const { return _window; }
+
+  /** @brief Returns reference to child UI elements.
+   * @return Z-ordered view of the element hierarchy.
+   */
+  ZOrder& get_children() { return _children; }
+
+  const std::vector<std::shared_ptr<AbstractUIElement>>& get_hit_children() {
+    return _hit_children;
+  }
+
+  /** @brief Sorts children recursively by Z-index.
+   * @note Stable, elements with equal Z-index keep their order.
+   * */
+  void sort_children(Composition& children) {
+    std::stable_sort(children.begin(), children.end(),
+              [](const std::shared_ptr<AbstractUIElement>& a,
+                 const std::shared_ptr<AbstractUIElement>& b) {
+                return a->z_index < b->z_index;
+              });
+
+    for (auto& child : children) {
+      if (child && !child->composition.empty())
+        sort_children(child->composition);
+    };
+  }
+
+  void sort_hit_children(Composition& children) {
+    std::sort(children.begin(), children.end(),
+              [](const std::shared_ptr<AbstractUIElement>& a,
+                 const std::shared_ptr<AbstractUIElement>& b) {
+                return a->z_index > b->z_index;
+              });
+
+    for (auto& child : children) {
+      if (child && !child->composition.empty())
+        sort_hit_children(child->composition);
+    };
+  }
+
+  /** @brief Updates the cached screen dimensions from the ncurses
+   * window.
+   * @note Called automatically by the resize event */
+  void update_dimensions();
+
+  /** @brief Applies pending panel restacking to the ncurses panel deck.
+   * @note Called automatically by UIContext::batch_render().
+   * */
+  void sync_panels() { _panels.flush(); }
+
+  /** @brief Sets the running state of the screen context to false. */
+  void stop() { _running = false; }
+
+  /** @brief Queries the running state of the screen context. */
+  bool is_running() const { return _running; }
+
+  /** @brief Adds child UI element to this context's hierarchy.
+   * @param child Unique ownership of element to add (moved into storage).
+   * @warning Child ownership transfers to ScreenContext. Do not reference
+   * after calling.
+   * */
+  void add_child(std::shared_ptr<AbstractUIElement> child);
+
+  /** @brief Deletes child UI element from this context's hierarchy.
+   * @param child Raw UI Element pointer (from any_child.get()).
+   * @note Safe if not found. Compares object addresses only.
+   * */
+  void del_child(AbstractUIElement* child);
+
+  /** @brief Repositions a child after its z_index changed.
+   * @param child Raw UI Element pointer (from any_child.get()).
+   * @note Safe if not found.
+   * */
+  void restack_child(AbstractUIElement* child);
+
+  /** @brief Moves a child in front of all children with the same z_index.
+   * @param child Raw UI Element pointer (from any_child.get()).
+   * @note Safe if not found.
+   * */
+  void bring_to_front(AbstractUIElement* child);
+
+  /** @brief Starts deferring bookkeeping until the matching commit().
+   *
+   * Between begin_update() and commit(), add_child(), del_child(),
+   * restack_child(), bring_to_front() and geometry changes of attached
+   * elements skip composition sorting, panel restacking, line index updates
+   * and line damage. commit() then reconciles them in a single pass, so
+   * loading a large graph costs one pass instead of one per element.
+   * @note Calls nest, only the outermost commit() reconciles.
+   * @warning hit_test() and edge_at() see moved elements at their old
+   * position until commit().
+   * */
+  void begin_update() { _update_depth++; }
+
+  /** @brief Ends an update started with begin_update().
+   * @note Safe to call without a matching begin_update().
+   * */
+  void commit();
+
+  /** @brief Returns true while an update is in progress. */
+  bool updating() const { return _update_depth > 0; }
+
+  /** @brief Clears the children UI hierarchy from this context.
+   * @note Safe to call at any point. Destroys all owned children.
+   * @note Releases the element arena at once if nothing else holds on to
+   * an element.
+   * */
+  void clear_children();
+
+  /** @brief Returns reference to the event manager for this context.
+   * @return Mutable reference to EventManager for event subscription/dispatch
+   * */
+  Event::Observer& observer() { return _observer; }
+
+  /** @brief Finds the line or curve closest to a point.
+   * @param x Horizontal position.
+   * @param y Vertical position.
+   * @param tolerance Maximum distance in characters from the edge.
+   * @return Closest line or curve or nullptr if none is within tolerance.
+   * @note Curves are measured against their flattened polyline.
+   * */
+  std::shared_ptr<AbstractUIElement> edge_at(int x,
+                                             int y,
+                                             int tolerance = 1) const;
+
+  /** @brief Result of a hit test. */
+  struct Hit {
+    std::shared_ptr<AbstractUIElement> element;
+    /** Top level element containing element, nullptr for edges. */
+    AbstractUIElement* root;
+  };
+
+  /** @brief Finds the front most clickable element at a point.
+   * @note Falls back to lines and curves within edge_tolerance. The last result is
+   * cached until the point or the scene version changes.
+   * */
+  Hit hit_test(int x, int y);
+
+  /** @brief Tests an element and its composition for a hit at a point.
+   * @return Front most clickable element containing the point, or nullptr.
+   * @note Uncached. Lines and curves are skipped, see edge_at().
+   * */
+  static std::shared_ptr<AbstractUIElement> hit_element(
+      const std::shared_ptr<AbstractUIElement>& element,
+      int x,
+      int y);
+
+  /** @brief Distance in characters within which an edge counts as hit. */
+  int edge_tolerance{1};
+
+  /** @brief Returns the resources to create elements of this context from,
+   * see ElementResources::make().
+   * */
+  const ElementResources& resources() const { return _resources; }
+
+  /** @brief Returns the arena elements of this context are allocated from.
+   * @note Released by clear_children() once no element of it is alive.
+   * */
+  ElementArena& arena() { return *_resources.arena; }
+  const ElementArena& arena() const { return *_resources.arena; }
+
+  /** @brief Makes elements created from now on draw into virtual surfaces
+   * composited through a shared layer instead of owning a window and panel.
+   * */
+  void set_virtual_surfaces(bool enabled) {
+    _resources.compositor->set_enabled(enabled);
+  }
+
+  /** @brief Returns the pool recycling windows and panels of destroyed
+   * elements. */
+  WindowPool& window_pool() { return *_resources.windows; }
+  const WindowPool& window_pool() const { return *_resources.windows; }
+
+  /** @brief Returns the compositor drawing virtual surfaces. */
+  Compositor& compositor() { return *_resources.compositor; }
+  const Compositor& compositor() const { return *_resources.compositor; }
+
+  /** @brief Returns the display list of the hierarchy, rebuilding it first
+   * if the structure changed since the last call. */
+  const DisplayList& display_list() {
+    _display.compile(_children);
+    return _display;
+  }
+
+  /** @brief Culls attached elements against the screen.
+   * @return Visibility of every store slot, see ElementStore::cull().
+   * */
+  std::span<const uint8_t> cull() {
+    _store.cull(Bounds{0, 0, _screen_width, _screen_height}, _visible);
+    return _visible;
+  }
+
+  /** @brief Starts or stops keeping snapshot state of attached elements.
+   * @note Disabled by default, costs one record write per change while
+   * enabled.
+   * */
+  void set_snapshots(bool enabled);
+
+  /** @brief Returns an immutable snapshot of the attached elements in O(1).
+   * @note Structural changes rerank every element after the change, so
+   * snapshots taken across them share fewer chunks.
+   * @warning Snapshots must be enabled, see set_snapshots().
+   * */
+  SceneSnapshot snapshot();
+
+  /** @brief Returns the structure-of-arrays state of attached elements. */
+  const ElementStore& store() const { return _store; }
+
+  /** @brief Returns the scene version.
+   * @note Bumped on every structural or geometric change of attached
+   * elements.
+   * */
+  uint64_t version() const { return _version; }
+
+  void element_moved(AbstractUIElement* element) override;
+  void element_added(AbstractUIElement* parent,
+                     AbstractUIElement* element) override {
+    attach(element, parent ? parent->handle : Handle{});
+  }
+  void element_removed(AbstractUIElement* element) override {
+    detach(element);
+  }
+  /** @brief Indexes the drawn path of an edge, so hit tests and damage
+   * follow what is on screen. */
+  void edge_drawn(AbstractUIElement* edge,
+                  std::span<const Coords> path) override;
+
+  /** @brief Marks every line and curve to be redrawn on the next render.
+   * @note Called automatically by the resize event.
+   * */
+  void damage_edges();
+
+  /** @brief Bookkeeping counters of this context. */
+  struct Stats {
+    size_t children{};
+    size_t elements{};
+    size_t panels{};
+    size_t edges{};
+    size_t hit_cache_hits{};
+    size_t hit_cache_misses{};
+  };
+
+  /** @brief Returns the current bookkeeping counters. */
+  Stats stats() const;
+};
+
+ScreenContext::Stats ScreenContext::stats() const {
+  return Stats{.children = _children.size(),
+               .elements = _store.size(),
+               .panels = _panels.size(),
+               .edges = _edges.size(),
+               .hit_cache_hits = _hit_cache_hits,
+               .hit_cache_misses = _hit_cache_misses};
+}
+
+void ScreenContext::attach(AbstractUIElement* element, Handle parent) {
+  if (!element)
+    return;
+  _version++;
+  _order_dirty = true;
+  _display.invalidate();
+  element->scene = this;
+  element->handle = _store.create(element, parent);
+  record(element->handle);
+  if (is_edge(element)) {
+    if (updating())
+      _pending_moves.insert(element);
+    else
+      index_edge(element);
+  }
+  for (auto& child : element->composition) {
+    attach(child.get(), element->handle);
+  }
+}
+
+void ScreenContext::detach(AbstractUIElement* element) {
+  if (!element)
+    return;
+  _version++;
+  _order_dirty = true;
+  _display.invalidate();
+  if (_snapshots_enabled && _store.alive(element->handle))
+    _snapshots.erase(element->handle.index);
+  _store.destroy(element->handle);
+  element->handle = Handle{};
+  element->scene = nullptr;
+  _pending_moves.erase(element);
+  if (is_edge(element)) {
+    if (element->type() == Type::Id::Line)
+      static_cast<UILine*>(element)->erase();
+    else
+      static_cast<UICurve*>(element)->erase();
+    _edges.for_each_near(element, damage_edge);
+    _edges.remove(element);
+  }
+  for (auto& child : element->composition) {
+    detach(child.get());
+  }
+}
+
+void ScreenContext::element_moved(AbstractUIElement* element) {
+  _version++;
+  // the list draws copies, keep them current while the rest of an update
+  // waits for commit()
+  _display.patch(element);
+  if (updating()) {
+    _pending_moves.insert(element);
+    return;
+  }
+  apply_move(element);
+}
+
+void ScreenContext::apply_move(AbstractUIElement* element) {
+  refresh(element);
+  if (is_edge(element)) {
+    // the index still holds the old footprint, redraw edges crossing it
+    _edges.for_each_near(element, damage_edge);
+    index_edge(element);
+  }
+}
+
+bool ScreenContext::is_edge(AbstractUIElement* element) {
+  Type::Id type = element->type();
+  return type == Type::Id::Line || type == Type::Id::Curve;
+}
+
+bool ScreenContext::index_edge(AbstractUIElement* element) {
+  if (element->type() == Type::Id::Line) {
+    auto line = static_cast<UILine*>(element);
+    return _edges.update(element, line->get_pos1(), line->get_pos2());
+  }
+  // curves are hit by their drawn polyline, not their bounding box
+  return _edges.update(element, static_cast<UICurve*>(element)->get_points());
+}
+
+void ScreenContext::edge_drawn(AbstractUIElement* edge,
+                               std::span<const Coords> path) {
+  if (!_store.alive(edge->handle) || _pending_moves.contains(edge))
+    return;
+  bool changed = path.empty() ? index_edge(edge) : _edges.update(edge, path);
+  if (changed)
+    _version++;
+}
+
+void ScreenContext::damage_edge(AbstractUIElement* element) {
+  if (element->type() == Type::Id::Line)
+    static_cast<UILine*>(element)->damage();
+  else
+    static_cast<UICurve*>(element)->damage();
+}
+
+void ScreenContext::record(Handle h) {
+  if (!_snapshots_enabled || !_store.alive(h))
+    return;
+  uint32_t i = h.index;
+  SceneRecord record{
+      .bounds = {_store.x[i], _store.y[i], _store.width[i], _store.height[i]},
+      .a = {},
+      .b = {},
+      .type = _store.type[i],
+      .flags = _store.flags[i],
+      .z_index = _store.z_index[i],
+      .parent = _store.parent[i],
+      .order = _store.order[i],
+      .generation = h.generation,
+      .text = {},
+      .alive = true};
+  if (record.type == Type::Id::Text) {
+    auto text = static_cast<UIText*>(_store.element[i]);
+    record.a = text->get_text_pos();
+    record.text = text->get_label();
+  } else if (record.type == Type::Id::Line) {
+    auto line = static_cast<UILine*>(_store.element[i]);
+    record.a = line->get_pos1();
+    record.b = line->get_pos2();
+  } else if (record.type == Type::Id::Curve) {
+    auto curve = static_cast<UICurve*>(_store.element[i]);
+    record.a = curve->get_pos1();
+    record.b = curve->get_pos2();
+  }
+  _snapshots.write(i, std::move(record));
+}
+
+void ScreenContext::set_snapshots(bool enabled) {
+  if (enabled == _snapshots_enabled)
+    return;
+  _snapshots_enabled = enabled;
+  _snapshots.clear();
+  if (!enabled)
+    return;
+  for (uint32_t i{}; i < _store.capacity(); i++) {
+    if (_store.element[i])
+      record(Handle{.index = i, .generation = _store.generation[i]});
+  }
+}
 
-  void configure_ncurses();
-  void cleanup_ncurses();
+SceneSnapshot ScreenContext::snapshot() {
+  refresh_order();
+  return _snapshots.snapshot(_version);
+}
 
- public:
-  ScreenContext();
-  ~ScreenContext();
+void ScreenContext::commit() {
+  if (_update_depth == 0)
+    return;
+  if (--_update_depth == 0)
+    reconcile();
+}
 
-  /** Disallows move/copy semantics */
-  ScreenContext(const ScreenContext&) = delete;
-  ScreenContext& operator=(const ScreenContext&) = delete;
-  ScreenContext(ScreenContext&&) = delete;
-  ScreenContext& operator=(ScreenContext&&) = delete;
+void ScreenContext::reconcile() {
+  for (AbstractUIElement* element : _pending_sort) {
+    // may have been deleted again during the update
+    if (_children.contains(element))
+      sort_children(element->composition);
+  }
+  if (!_pending_sort.empty()) {
+    _order_dirty = true;
+    _display.invalidate();
+  }
+  _pending_sort.clear();
 
-  /** @brief Returns the current screen width in characters.
-   * @return Cached width from last ncurses query.
-   */
-  int get_width() const { return _screen_width; }
+  for (AbstractUIElement* element : _pending_moves) {
+    apply_move(element);
+  }
+  _pending_moves.clear();
 
-  /** @brief Returns the current screen height in characters.
-   * @return Cached height from last ncurses query.
-   */
-  int get_height() const { return _screen_height; }
+  if (_pending_panels) {
+    AbstractUIElement* below{nullptr};
+    for (auto& child : _children) {
+      _panels.place(child.get(), below);
+      below = child.get();
+    }
+    _pending_panels = false;
+  }
+}
 
-  /**
-   * @brief Returns the raw ncurses window handle.
-   * @return Pointer to underlying WINDOW (do not delete).
-   * @warning Direct ncurses usage bypasses RAII safety.
-   */
-  WINDOW* get_window() const { return _window; }
+void ScreenContext::refresh(AbstractUIElement* element) {
+  _store.update(element->handle);
+  record(element->handle);
+  for (auto& child : element->composition) {
+    if (child->shares_window(element) && child->type() != Type::Id::Line)
+      refresh(child.get());
+  }
+}
 
-  /** @brief Returns const reference to child UI elements.
-   * @return Read-only view of the element hierarchy.
-   */
-  std::vector<std::shared_ptr<AbstractUIElement>>& get_children() {
-    return _children;
+void ScreenContext::refresh_order() {
+  if (!_order_dirty)
+    return;
+  uint32_t rank{};
+  for (auto& child : _children) {
+    refresh_order(child.get(), rank);
   }
+  _order_dirty = false;
+}
 
-  const std::vector<std::shared_ptr<AbstractUIElement>>& get_hit_children() {
-    return _hit_children;
+void ScreenContext::refresh_order(AbstractUIElement* element, uint32_t& rank) {
+  // compositions are hit before the element that owns them
+  if (_store.alive(element->handle)) {
+    uint32_t& order = _store.order[element->handle.index];
+    bool changed = order != rank;
+    order = rank++;
+    if (changed)
+      record(element->handle);
   }
+  for (auto& child : element->composition) {
+    refresh_order(child.get(), rank);
+  }
+}
 
-  /** @brief Sorts children recursively by Z-index.
-   * */
-  void sort_children(
-      std::vector<std::shared_ptr<AbstractUIElement>>& children) {
-    std::sort(children.begin(), children.end(),
-              [](const std::shared_ptr<AbstractUIElement>& a,
-                 const std::shared_ptr<AbstractUIElement>& b) {
-                return a->z_index < b->z_index;
-              });
+void ScreenContext::damage_edges() {
+  _edges.for_each(damage_edge);
+}
 
-    for (auto& child : children) {
-      if (child->panel)
-        _panels.emplace_back(child->panel);
-      if (child && !child->composition.empty())
-        sort_children(child->composition);
-    };
+ScreenContext::Hit ScreenContext::hit_test(int x, int y) {
+  if (_hit_cache.valid && _hit_cache.x == x && _hit_cache.y == y &&
+      _hit_cache.version == _version) {
+    _hit_cache_hits++;
+    return Hit{.element = _hit_cache.element.lock(), .root = _hit_cache.root};
   }
+  _hit_cache_misses++;
 
-  void sort_hit_children(
-      std::vector<std::shared_ptr<AbstractUIElement>>& children) {
-    std::sort(children.begin(), children.end(),
-              [](const std::shared_ptr<AbstractUIElement>& a,
-                 const std::shared_ptr<AbstractUIElement>& b) {
-                return a->z_index > b->z_index;
-              });
+  refresh_order();
 
-    for (auto& child : children) {
-      if (child && !child->composition.empty())
-        sort_hit_children(child->composition);
-    };
+  // stream the store instead of walking the element tree
+  uint32_t best = ElementStore::npos;
+  for (uint32_t i{}; i < _store.capacity(); i++) {
+    if (!_store.element[i] || _store.type[i] == Type::Id::Line ||
+        _store.type[i] == Type::Id::Curve ||
+        (_store.flags[i] & Type::Flags::Clickable) != Type::Flags::Clickable)
+      continue;
+    if (x < _store.x[i] || x >= _store.x[i] + _store.width[i] ||
+        y < _store.y[i] || y >= _store.y[i] + _store.height[i])
+      continue;
+    if (best == ElementStore::npos || _store.order[i] > _store.order[best])
+      best = i;
   }
 
-  /** @brief Updates the cached screen dimensions from the ncurses
-   * window.
-   * @note Called automatically by the resize event */
-  void update_dimensions();
+  Hit hit{.element = nullptr, .root = nullptr};
+  if (best != ElementStore::npos) {
+    hit.element = _store.element[best]->shared_from_this();
+    hit.root = _store.element[_store.root(best)];
+  } else {
+    auto edge = edge_at(x, y, edge_tolerance);
+    if (edge &&
+        (edge->flags & Type::Flags::Clickable) == Type::Flags::Clickable)
+      hit.element = edge;
+  }
 
-  /** @brief Sets the running state of the screen context to false. */
-  void stop() { _running = false; }
+  _hit_cache = HitCache{.x = x,
+                        .y = y,
+                        .version = _version,
+                        .valid = true,
+                        .element = hit.element,
+                        .root = hit.root};
+  return hit;
+}
 
-  /** @brief Queries the running state of the screen context. */
-  bool is_running() const { return _running; }
+std::shared_ptr<AbstractUIElement> ScreenContext::hit_element(
+    const std::shared_ptr<AbstractUIElement>& element,
+    int x,
+    int y) {
+  if (!element)
+    return nullptr;
 
-  /** @brief Adds child UI element to this context's hierarchy.
-   * @param child Unique ownership of element to add (moved into storage).
-   * @warning Child ownership transfers to ScreenContext. Do not reference
-   * after calling.
-   * */
-  void add_child(std::shared_ptr<AbstractUIElement> child);
+  for (auto& child : std::ranges::reverse_view(element->composition)) {
+    if (auto hit = hit_element(child, x, y))
+      return hit;
+  }
 
-  /** @brief Deletes child UI element from this context's hierarchy.
-   * @param child Raw UI Element pointer (from any_child.get()).
-   * @note Safe if not found. Compares object addresses only.
-   * */
-  void del_child(AbstractUIElement* child);
+  if (is_edge(element.get()))
+    return nullptr;
 
-  /** @brief Clears the children UI hierarchy from this context.
-   * @note Safe to call at any point. Destroys all owned children.
-   * */
-  void clear_children();
+  if ((element->flags & Type::Flags::Clickable) != Type::Flags::Clickable)
+    return nullptr;
+  Bounds b = element->get_bounds();
+  if (x >= b.x && x < b.x + b.width && y >= b.y && y < b.y + b.height)
+    return element;
+  return nullptr;
+}
 
-  /** @brief Returns reference to the event manager for this context.
-   * @return Mutable reference to EventManager for event subscription/dispatch
-   * */
-  Event::Observer& observer() { return _observer; }
-};
+std::shared_ptr<AbstractUIElement> ScreenContext::edge_at(
+    int x,
+    int y,
+    int tolerance) const {
+  auto element = _edges.query(x, y, tolerance);
+  if (!element)
+    return nullptr;
+  return element->shared_from_this();
+}
 
 void ScreenContext::add_child(std::shared_ptr<AbstractUIElement> child) {
   if (!child)
     return;
-  _children.emplace_back(child);
-  // _hit_children.emplace_back(child);
-  sort_children(_children);
-  // sort_hit_children(_hit_children);
-  // update_panels();
+  if (_children.contains(child.get()))
+    return;
+  auto element = child.get();
+  if (updating()) {
+    _pending_sort.emplace_back(element);
+    _pending_panels = true;
+    attach(element);
+    _children.insert(std::move(child));
+    return;
+  }
+  sort_children(child->composition);
+  attach(element);
+  _children.insert(std::move(child));
+  _panels.place(element, _children.below(element));
 }
 
 void ScreenContext::del_child(AbstractUIElement* child) {
   if (!child)
     return;
-  auto it =
-      std::find_if(_children.begin(), _children.end(),
-                   [&child](const auto& ptr) { return ptr.get() == child; });
-  if (it != _children.end()) {
-    _children.erase(it);
+  if (_children.contains(child)) {
+    detach(child);
+    _panels.remove(child);
+    _children.erase(child);
+  }
+}
+
+void ScreenContext::restack_child(AbstractUIElement* child) {
+  _version++;
+  _order_dirty = true;
+  _display.invalidate();
+  _store.update(child->handle);
+  record(child->handle);
+  _children.restack(child);
+  if (updating()) {
+    _pending_panels = true;
+    return;
+  }
+  _panels.place(child, _children.below(child));
+}
+
+void ScreenContext::bring_to_front(AbstractUIElement* child) {
+  _version++;
+  _order_dirty = true;
+  _display.invalidate();
+  _children.bring_to_front(child);
+  if (updating()) {
+    _pending_panels = true;
+    return;
   }
+  _panels.place(child, _children.below(child));
 }
 
 ScreenContext::ScreenContext()
@@ -863,19 +5560,36 @@ ScreenContext::ScreenContext()
       _oldmask(0),
       _screen_width(0),
       _screen_height(0),
-      _running(false) {
+      _running(false),
+      _resources{.arena = std::make_shared<ElementArena>(),
+                 .compositor = std::make_shared<Compositor>(),
+                 .windows = std::make_shared<WindowPool>()} {
   configure_ncurses();
 }
 
 ScreenContext::~ScreenContext() {
+  clear_children();
+  // elements may outlive the context and keep the compositor alive
+  _resources.compositor->release();
+  // elements outliving the context delete their windows directly
+  _resources.windows->capacity = 0;
+  _resources.windows->clear();
   cleanup_ncurses();
 }
 
 void ScreenContext::clear_children() {
+  for (auto& child : _children) {
+    detach(child.get());
+  }
+  _pending_sort.clear();
+  _panels.clear();
   _children.clear();
+  _resources.arena->release();
 }
 
 void ScreenContext::configure_ncurses() {
+  // wide characters such as Braille need the user's UTF-8 locale
+  setlocale(LC_ALL, "");
   _window = initscr();
   if (!_window) {
     throw std::runtime_error("Failed to initialize ncurses window");
@@ -913,10 +5627,14 @@ void ScreenContext::update_dimensions() {
     return;
   }
   getmaxyx(_window, _screen_height, _screen_width);
+  _resources.compositor->resize(_screen_width, _screen_height);
+  _version++;
 }
 
 /** @brief Internal renderer supporting shared_ptr and unique ptr hierarchies.
  * @note Private implementation. Use UIContext::start() instead.
+ * @note Traverses by reference with non-owning element pointers, so a frame
+ * copies no child lists and touches no reference counts.
  * */
 class Renderer {
  public:
@@ -925,7 +5643,7 @@ class Renderer {
    * @note Internal. Use UIContext::start() instead to avoid flickering and
    * perf overhead.
    * */
-  void render(std::vector<std::shared_ptr<AbstractUIElement>> children) {
+  void render(std::span<const std::shared_ptr<AbstractUIElement>> children) {
     render_impl(children);
   };
 
@@ -938,18 +5656,371 @@ class Renderer {
     render_impl(children);
   };
 
+  /** @brief Recursively renders a z-ordered UI element hierarchy.
+   * @param children Z-ordered hierarchy to render.
+   * @note Internal. Use UIContext::start() instead to avoid flickering and
+   * perf overhead.
+   * */
+  void render(const ZOrder& children) { render_impl(children); };
+
+  /** @brief Renders a compiled display list in a single linear pass.
+   * @param list Display list to execute.
+   * @param compositor Compositor drawing virtual surfaces, see
+   * ScreenContext::compositor(). Surfaces are skipped if null.
+   * @param visible Visibility of store slots, see ScreenContext::cull().
+   * Boxes and texts of hidden slots are skipped. Empty draws everything.
+   * @note Consecutive commands drawing into the same window share one
+   * wnoutrefresh. Damaged lines on stdscr are rasterized first in one batch,
+   * see EdgeRaster, or together with curves in the canvas of the edge style,
+   * see set_edge_style().
+   * @note Internal. Use UIContext::start() instead to avoid flickering and
+   * perf overhead.
+   * */
+  void render(const DisplayList& list,
+              Compositor* compositor,
+              std::span<const uint8_t> visible = {});
+
+  /** @brief Renders a scene snapshot into a single window, back to front.
+   * @param snapshot Snapshot to draw, see ScreenContext::snapshot().
+   * @param target Window to draw into, e.g. stdscr.
+   * @note Reads nothing but the snapshot, so a frame stays consistent
+   * however the scene changed since it was taken. Boxes are opaque.
+   * @warning Must run on the thread that owns ncurses, like every other
+   * render. Build a SnapshotFrame to prepare the frame on another thread.
+   * */
+  void render(const SceneSnapshot& snapshot, WINDOW* target) {
+    render(SnapshotFrame(snapshot), target);
+  }
+
+  /** @brief Draws a snapshot frame into a single window.
+   * @param frame Frame to draw, possibly built on another thread.
+   * @param target Window to draw into, e.g. stdscr.
+   * @warning Must run on the thread that owns ncurses.
+   * */
+  void render(const SnapshotFrame& frame, WINDOW* target);
+
+  /** @brief Sets how lines and curves on stdscr are drawn.
+   * @note All edges are redrawn on the next render.
+   * */
+  void set_edge_style(EdgeStyle style);
+
+  /** @brief Returns how lines and curves on stdscr are drawn. */
+  EdgeStyle edge_style() const { return _edge_style; }
+
+  /** @brief Sets how long a render waits for its bundles, see
+   * EdgeStyle::Bundled.
+   * @note Bundles missing the wait are shown by a later render.
+   * */
+  void set_bundle_wait(std::chrono::microseconds wait) { _bundle_wait = wait; }
+
+  /** @brief Returns how long the event loop may block on input, in ms.
+   * @return -1 unless bundles are still due on screen.
+   * */
+  int idle_timeout() const {
+    bool pending = _edge_style == EdgeStyle::Bundled &&
+                   _bundles_shown < _bundles_submitted;
+    return pending ? 16 : -1;
+  }
+
  private:
+  EdgeRaster _raster;
+  SegmentClipper _clipper;
+  BrailleCanvas _canvas;
+  JunctionCanvas _junctions;
+  EdgeRouter _router;
+  EdgeBundler _bundler;
+  EdgeCache _edge_cache;
+  /** Version of the bundles on screen. */
+  uint64_t _bundles_shown{};
+  /** Version of the latest edges handed to the bundler. */
+  uint64_t _bundles_submitted{};
+  std::chrono::microseconds _bundle_wait{std::chrono::milliseconds(8)};
+  EdgeStyle _edge_style{EdgeStyle::Lines};
+  /** Set to redraw every edge on the next render, e.g. after a mode
+   * switch. */
+  bool _redraw_edges{false};
+  std::vector<EdgeRouter::Edge> _edges;
+  std::vector<EdgeRouter::Edge> _curves;
+
+  /** @brief Rasterizes all damaged lines drawn on stdscr in one pass. */
+  void render_edges(const DisplayList& list);
+
   template <class C>
   void render_impl(const C& children) {
     for (auto& child : children) {
-      if (child->composition.size() > 0) {
-        render(child->composition);
-      }
-      child->render();
+      render_element(child.get());
+    }
+  }
+
+  void render_element(AbstractUIElement* element) {
+    for (auto& child : element->composition) {
+      render_element(child.get());
     }
+    element->render();
   }
 };
 
+void Renderer::set_edge_style(EdgeStyle style) {
+  if (style == _edge_style)
+    return;
+  _edge_style = style;
+  _canvas.clear();
+  _junctions.clear();
+  _redraw_edges = true;
+}
+
+void Renderer::render_edges(const DisplayList& list) {
+  bool redraw = std::exchange(_redraw_edges, false);
+  bool damaged = redraw;
+  _edge_cache.age();
+  // canvas styles share cells between edges and redraw them all
+  bool canvas = _edge_style != EdgeStyle::Lines;
+  bool orthogonal = _edge_style == EdgeStyle::Orthogonal ||
+                    _edge_style == EdgeStyle::Routed;
+  // keys are the elements, so hit tests can follow the path drawn
+  auto drawn = [](const void* key, std::span<const Coords> path) {
+    auto* edge = static_cast<AbstractUIElement*>(const_cast<void*>(key));
+    if (edge->scene)
+      edge->scene->edge_drawn(edge, path);
+  };
+  _edges.clear();
+  _curves.clear();
+  for (const DrawCommand& cmd : list.commands()) {
+    if (cmd.window != stdscr)
+      continue;
+    if (cmd.kind == DrawCommand::Kind::Line) {
+      auto* line = static_cast<UILine*>(cmd.element);
+      bool dirty = line->take_damage();
+      damaged |= dirty;
+      if (!(dirty || redraw || canvas))
+        continue;
+      // only the Lines style leaves glyphs a later move has to erase,
+      // switching to a canvas style blanks them once
+      if (!canvas)
+        line->mark_drawn();
+      else if (redraw)
+        line->erase();
+      if (redraw && !orthogonal)
+        drawn(cmd.element, {});
+      _edges.emplace_back(cmd.element, line->get_pos1(), line->get_pos2());
+    } else if (cmd.kind == DrawCommand::Kind::Curve) {
+      auto* curve = static_cast<UICurve*>(cmd.element);
+      if (redraw && !orthogonal)
+        drawn(cmd.element, {});
+      if (!canvas) {
+        if (redraw)
+          curve->damage();
+        continue;
+      }
+      if (redraw)
+        curve->erase();
+      damaged |= curve->take_damage();
+      _curves.emplace_back(cmd.element, curve->get_pos1(), curve->get_pos2());
+    }
+  }
+
+  int width = getmaxx(stdscr);
+  int height = getmaxy(stdscr);
+  if (_edge_style == EdgeStyle::Routed) {
+    // boxes moving under routes need rerouting even if no edge moved
+    _router.begin_obstacles(width, height);
+    for (const DrawCommand& cmd : list.commands()) {
+      if (cmd.kind == DrawCommand::Kind::Box && cmd.window != stdscr)
+        _router.add_obstacle(cmd.element, cmd.element->get_bounds());
+    }
+    damaged |= _router.end_obstacles();
+  }
+  if (_edge_style == EdgeStyle::Bundled) {
+    // bundles usually arrive within the frame, otherwise the event loop
+    // polls until a render shows them, see idle_timeout()
+    if (damaged) {
+      _edges.insert(_edges.end(), _curves.begin(), _curves.end());
+      _bundles_submitted = _bundler.submit(_edges);
+      _bundler.wait(_bundles_submitted, _bundle_wait);
+    }
+    auto bundles = _bundler.result();
+    damaged |= bundles && bundles->version != _bundles_shown;
+  }
+  if (!damaged)
+    return;
+
+  _canvas.resize(width, height);
+  _junctions.resize(width, height);
+  // blank what the previous style left behind
+  if (redraw) {
+    if (_edge_style != EdgeStyle::Braille &&
+        _edge_style != EdgeStyle::Bundled)
+      _canvas.flush(stdscr);
+    if (_edge_style != EdgeStyle::Orthogonal &&
+        _edge_style != EdgeStyle::Routed)
+      _junctions.flush(stdscr);
+    wnoutrefresh(stdscr);
+  }
+
+  if (_edge_style == EdgeStyle::Braille) {
+    _canvas.clear();
+    for (const auto& [key, pos1, pos2] : _edges) {
+      _canvas.line(BrailleCanvas::to_dots(pos1), BrailleCanvas::to_dots(pos2));
+    }
+    // flattening costs more than copying masks, so curves keep theirs while
+    // their shape holds, e.g. when panning
+    for (const auto& [key, pos1, pos2] : _curves) {
+      _canvas.blit(pos1, _edge_cache.get(key, pos1, pos2,
+                                         BrailleCanvas::curve_cells));
+    }
+    _canvas.flush(stdscr);
+    wnoutrefresh(stdscr);
+    return;
+  }
+  if (_edge_style == EdgeStyle::Bundled) {
+    _canvas.clear();
+    if (auto bundles = _bundler.result()) {
+      for (const auto& [pos1, pos2] : bundles->segments) {
+        _canvas.line(BrailleCanvas::to_dots(pos1),
+                     BrailleCanvas::to_dots(pos2));
+      }
+      _bundles_shown = bundles->version;
+    }
+    _canvas.flush(stdscr);
+    wnoutrefresh(stdscr);
+    return;
+  }
+  if (_edge_style == EdgeStyle::Orthogonal) {
+    _junctions.clear();
+    _edges.insert(_edges.end(), _curves.begin(), _curves.end());
+    for (const auto& [key, pos1, pos2] : _edges) {
+      auto elbow = JunctionCanvas::elbow(pos1, pos2);
+      _junctions.path(elbow);
+      drawn(key, elbow);
+    }
+    _junctions.flush(stdscr);
+    wnoutrefresh(stdscr);
+    return;
+  }
+  if (_edge_style == EdgeStyle::Routed) {
+    // curves are routed like lines
+    _edges.insert(_edges.end(), _curves.begin(), _curves.end());
+    _router.update(_edges);
+    _junctions.clear();
+    for (const EdgeRouter::Edge& edge : _edges) {
+      _junctions.path(_router.path(edge.key));
+      drawn(edge.key, _router.path(edge.key));
+    }
+    _junctions.flush(stdscr);
+    wnoutrefresh(stdscr);
+    return;
+  }
+  if (_edges.empty())
+    return;
+  // clipped in one batch, so only visible steps are traced. Plotted in
+  // display order so crossings keep the glyph of the topmost line; the
+  // raster is written out row by row regardless.
+  _clipper.clear();
+  for (const auto& [key, pos1, pos2] : _edges) {
+    _clipper.add(pos1, pos2);
+  }
+  _clipper.clip(width, height);
+  _raster.resize(width, height);
+  for (size_t i{}; i < _edges.size(); i++) {
+    if (_clipper.first(i) <= _clipper.last(i))
+      _raster.plot(_edges[i].pos1, _edges[i].pos2, _clipper.first(i),
+                   _clipper.last(i));
+  }
+  if (_raster.flush(stdscr))
+    wnoutrefresh(stdscr);
+}
+
+void Renderer::render(const DisplayList& list,
+                      Compositor* compositor,
+                      std::span<const uint8_t> visible) {
+  render_edges(list);
+  // window whose wnoutrefresh is deferred until a command draws elsewhere
+  WINDOW* pending{nullptr};
+  auto flush = [&pending]() {
+    if (pending)
+      wnoutrefresh(pending);
+    pending = nullptr;
+  };
+  for (const DrawCommand& cmd : list.commands()) {
+    // lines erase their old cells even when they leave the screen, other
+    // elements may draw outside of their bounds
+    bool culled = cmd.kind == DrawCommand::Kind::Box ||
+                  cmd.kind == DrawCommand::Kind::Text;
+    if (culled && cmd.slot < visible.size() && !visible[cmd.slot])
+      continue;
+    if (cmd.window != pending || cmd.surface)
+      flush();
+    switch (cmd.kind) {
+      case DrawCommand::Kind::Box:
+        if (cmd.surface) {
+          if (compositor)
+            compositor->draw_box(*cmd.surface);
+          break;
+        }
+        box(cmd.window, 0, 0);
+        pending = cmd.window;
+        break;
+      case DrawCommand::Kind::Text:
+        if (cmd.surface) {
+          if (compositor)
+            compositor->draw_text(*cmd.surface, cmd.a, cmd.text);
+          break;
+        }
+        mvwaddnstr(cmd.window, cmd.a.y, cmd.a.x, cmd.text.data(),
+                   static_cast<int>(cmd.text.size()));
+        pending = cmd.window;
+        break;
+      case DrawCommand::Kind::Line:
+        // lines on stdscr were drawn by render_edges()
+        if (cmd.window == stdscr)
+          break;
+        flush();
+        // lines track their own damage, see UILine::render(). Only exact
+        // UILine and UICurve elements get these kinds, see DisplayList.
+        static_cast<UILine*>(cmd.element)->UILine::render();
+        break;
+      case DrawCommand::Kind::Curve:
+        // canvas styles draw curves on stdscr in render_edges()
+        if (_edge_style != EdgeStyle::Lines && cmd.window == stdscr)
+          break;
+        flush();
+        static_cast<UICurve*>(cmd.element)->UICurve::render();
+        break;
+      case DrawCommand::Kind::Element:
+        flush();
+        cmd.element->render();
+        break;
+    }
+  }
+  flush();
+}
+
+void Renderer::render(const SnapshotFrame& frame, WINDOW* target) {
+  for (const SceneRecord* record : frame.records()) {
+    const Bounds& b = record->bounds;
+    switch (record->type) {
+      case Type::Id::Box:
+        for (int row{}; row < b.height; row++) {
+          mvwhline(target, b.y + row, b.x, ' ', b.width);
+        }
+        Compositor::outline(target, b.x, b.y, b.width, b.height);
+        break;
+      case Type::Id::Text:
+        mvwaddnstr(target, b.y + record->a.y, b.x + record->a.x,
+                   record->text.data(), static_cast<int>(record->text.size()));
+        break;
+      case Type::Id::Line:
+        UILine::draw(target, record->a, record->b, false);
+        break;
+      case Type::Id::Curve:
+        UICurve::draw(target, record->a, record->b, false);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
 /** @brief RAII UI context that renders child hierarchy and dispatches ncurses
  * events.
  *
@@ -976,18 +6047,75 @@ class UIContext : public ScreenContext, public Renderer {
    * @note Internal. Automatically called from unique_ptr-based
    * handle_click().
    * */
-  bool handle_click(
-      const std::vector<std::shared_ptr<AbstractUIElement>>& children);
+  bool handle_click(const Composition& children);
+
+  /** @brief Selects the clickable element under the mouse and brings its top
+   * level element to the front of its z_index.
+   * @note Uses the cached ScreenContext::hit_test().
+   * */
+  bool handle_click();
+
+  /** @brief Sets the selected element and drag offset of the mouse event
+   * data. */
+  void select(std::shared_ptr<AbstractUIElement> element);
+
+  /** @brief Clears the children UI hierarchy and drops the event handlers
+   * of the destroyed elements.
+   * @note Handlers hold lifetime tokens from the element arena, so they go
+   * before the arena is released.
+   * */
+  void clear_children();
 
-  /** @brief Wraps render() with a single wnoutrefresh() + doupdate() for
+  /** @brief Wraps render() with a single update_panels() + doupdate() for
    * efficiency and to avoid flickering.
    * @note Internal method. Use start() instead to insure children exist.
    * */
   void batch_render();
+
+  /** @brief Live counters for watching memory in long running sessions. */
+  struct Stats {
+    ScreenContext::Stats scene;
+    /** Attached elements by Type::Id. */
+    std::array<size_t, Type::id_count> elements{};
+    /** Bytes held by attached elements and their compositions, by
+     * Type::Id. */
+    std::array<size_t, Type::id_count> element_bytes{};
+    /** Registered event handlers by Event::Type, expired ones included. */
+    std::array<size_t, Event::type_count> callbacks{};
+    /** ncurses windows and panels from the window pool and compositor
+     * alive, free pooled ones included. */
+    size_t windows{};
+    size_t panels{};
+    size_t arena_bytes{};
+    size_t arena_peak_bytes{};
+    size_t arena_live{};
+
+    size_t count(Type::Id id) const {
+      return elements[static_cast<size_t>(id)];
+    }
+    size_t bytes(Type::Id id) const {
+      return element_bytes[static_cast<size_t>(id)];
+    }
+    size_t handlers(Event::Type type) const {
+      return callbacks[static_cast<size_t>(type)];
+    }
+  };
+
+  /** @brief Returns the current live counters.
+   * @note Walks every attached element, meant for periodic sampling.
+   * */
+  Stats stats() const;
 };
 
 UIContext::UIContext() {}
 
+void UIContext::clear_children() {
+  ScreenContext::clear_children();
+  mouse_event.prune();
+  screen_event.prune();
+  arena().release();
+}
+
 void UIContext::start() {
   batch_render();
 
@@ -997,7 +6125,13 @@ void UIContext::start() {
   mouse_event.data.ctx = this;
 
   while (is_running()) {
+    wtimeout(win, idle_timeout());
     c = wgetch(win);
+    // timed out, only renders are due
+    if (c == ERR) {
+      batch_render();
+      continue;
+    }
     if (c == 'q') {
       stop();
       break;
@@ -1006,6 +6140,7 @@ void UIContext::start() {
     wnoutrefresh(win);
     if (c == KEY_RESIZE) {
       update_dimensions();
+      damage_edges();
       screen_event.data.ctx = this;
       screen_event.data.height = ScreenContext::get_height();
       screen_event.data.width = ScreenContext::get_width();
@@ -1016,9 +6151,11 @@ void UIContext::start() {
       while (getmouse(&event) == OK) {
         mouse_event.data.x = event.x;
         mouse_event.data.y = event.y;
+        mouse_event.data.hovered_element =
+            hit_test(event.x, event.y).element;
         observer().notify(Event::Type::Mousemove);
         if (event.bstate & BUTTON1_PRESSED) {
-          handle_click(get_children());
+          handle_click();
           observer().notify(Event::Type::Mousedown);
           // for (auto& ele : mouse_event.data.hits) {
           // logToFile(std::to_string(reinterpret_cast<uintptr_t>(ele->window)));
@@ -1034,76 +6171,166 @@ void UIContext::start() {
   }
 }
 
+UIContext::Stats UIContext::stats() const {
+  Stats stats{.scene = ScreenContext::stats(),
+              .windows = window_pool().live_windows() + compositor().windows(),
+              .panels = window_pool().live_panels(),
+              .arena_bytes = arena().bytes(),
+              .arena_peak_bytes = arena().peak_bytes(),
+              .arena_live = arena().live()};
+
+  const ElementStore& elements = store();
+  for (uint32_t i{}; i < elements.capacity(); i++) {
+    AbstractUIElement* element = elements.element[i];
+    if (!element)
+      continue;
+    auto id = static_cast<size_t>(elements.type[i]);
+    size_t bytes{};
+    switch (elements.type[i]) {
+      case Type::Id::Box:
+        bytes = sizeof(UIBox);
+        break;
+      case Type::Id::Text:
+        bytes =
+            sizeof(UIText) + static_cast<UIText*>(element)->get_label().size();
+        break;
+      case Type::Id::Button:
+        bytes = sizeof(UIButton);
+        break;
+      case Type::Id::Line:
+        bytes = sizeof(UILine);
+        break;
+      case Type::Id::Curve:
+        bytes = sizeof(UICurve) + static_cast<UICurve*>(element)
+                                      ->get_points()
+                                      .size_bytes();
+        break;
+      case Type::Id::Node:
+        bytes = sizeof(UINode);
+        break;
+      default:
+        bytes = sizeof(AbstractUIElement);
+        break;
+    }
+    bytes += element->composition.capacity() *
+             sizeof(std::shared_ptr<AbstractUIElement>);
+    stats.elements[id]++;
+    stats.element_bytes[id] += bytes;
+  }
+
+  for (size_t t{}; t < Event::type_count; t++) {
+    auto type = static_cast<Event::Type>(t);
+    stats.callbacks[t] = mouse_event.count(type) + screen_event.count(type);
+  }
+  return stats;
+}
+
 void UIContext::batch_render() {
+  sync_panels();
+  compositor().begin_frame();
   wnoutrefresh(get_window());
-  render(get_children());
+  render(display_list(), &compositor(), cull());
+  // restacked panels were touched, so this copies them and whatever they
+  // now cover over the frame
+  update_panels();
   doupdate();
 }
 
-bool UIContext::handle_click(
-    const std::vector<std::shared_ptr<AbstractUIElement>>& children) {
+bool UIContext::handle_click(const Composition& children) {
   for (auto& child : std::ranges::reverse_view(children)) {
-    if (!child)
-      continue;
-
-    if (!child->composition.empty()) {
-      if (handle_click(child->composition))
-        return true;
-    }
-
-    if ((child->flags & Type::Flags::Clickable) == Type::Flags::Clickable &&
-        wenclose(child->window, mouse_event.data.y, mouse_event.data.x)) {
-      mouse_event.data.selected_element = child;
-      // logToFile(std::to_string(reinterpret_cast<uintptr_t>(child->window)));
+    if (auto hit = hit_element(child, mouse_event.data.x, mouse_event.data.y)) {
+      select(std::move(hit));
       return true;
     }
   }
   return false;
 }
 
+bool UIContext::handle_click() {
+  auto hit = hit_test(mouse_event.data.x, mouse_event.data.y);
+  if (!hit.element)
+    return false;
+  select(std::move(hit.element));
+  if (hit.root)
+    bring_to_front(hit.root);
+  return true;
+}
+
+void UIContext::select(std::shared_ptr<AbstractUIElement> element) {
+  if (element) {
+    Bounds b = element->get_bounds();
+    mouse_event.data.offset_x = mouse_event.data.x - b.x;
+    mouse_event.data.offset_y = mouse_event.data.y - b.y;
+  }
+  // logToFile(std::to_string(reinterpret_cast<uintptr_t>(element->window)));
+  mouse_event.data.selected_element = std::move(element);
+}
+
 template <typename F>
 UIButton::UIButton(Event::MouseEvent* event,
                    std::string label,
                    int x,
                    int y,
-                   F&& callback) {
-  auto box = UIBox::create();
-  auto text = UIText::create(x, y, label, box->window);
+                   F&& callback,
+                   const ElementResources& res)
+    : IUIElement(res) {
+  auto box = UIBox::create(0, 0, 0, 0, nullptr, res);
+  auto text = UIText::create(x, y, label, box->window, res);
+  text->set_surface(box->surface);
   box->set_dimensions(text->get_width(), text->get_height());
   box->flags |= Type::Flags::Clickable;
   this->window = box->window;
-  this->panel = new_panel(this->window);
+  this->surface = box->surface;
+  if (this->window)
+    this->panel = res.panel(this->window);
 
   composition.emplace_back(box);
   composition.emplace_back(text);
 
-  event->add(Event::Type::Click, [&](Event::MouseData d) {
-    if (d.selected_element && d.selected_element->window == this->window) {
-      callback(d);
-    }
-  });
+  if constexpr (!std::is_null_pointer_v<std::remove_cvref_t<F>>)
+    this->callback = ElementCallback<Event::MouseData>(
+        res, std::forward<F>(callback));
+
+  // only capture this so the handler fits std::function's inline storage
+  event->add(
+      Event::Type::Click,
+      [this](Event::MouseData d) {
+        if (this->callback && d.selected_element &&
+            d.selected_element->shares_window(this)) {
+          this->callback(d);
+        }
+      },
+      lifetime());
 }
 
-std::shared_ptr<UIButton> UIButton::create(
-    Event::MouseEvent* event,
-    std::string label,
-    int x,
-    int y,
-    std::function<void(Event::MouseData)> callback = {}) {
-  return std::make_shared<UIButton>(event, label, x, y, callback);
+template <typename F>
+std::shared_ptr<UIButton> UIButton::create(Event::MouseEvent* event,
+                                           std::string label,
+                                           int x,
+                                           int y,
+                                           F&& callback,
+                                           const ElementResources& res) {
+  return res.make<UIButton>(event, label, x, y, std::forward<F>(callback));
 }
 
 template <typename F>
-UINode::UINode(Event::MouseEvent* e, int x, int y, std::string label, F&& c0b) {
-  auto box = UIBox::create();
-  auto text = UIText::create(x, y, label, box->window);
+UINode::UINode(Event::MouseEvent* e,
+               int x,
+               int y,
+               std::string label,
+               F&& c0b,
+               const ElementResources& res)
+    : IUIElement(res) {
+  auto box = UIBox::create(0, 0, 0, 0, nullptr, res);
+  auto text = UIText::create(x, y, label, box->window, res);
+  text->set_surface(box->surface);
   box->set_dimensions(text->get_width(), text->get_height());
   box->flags |= Type::Flags::Clickable;
 
   this->x = x;
   this->y = y;
   this->window = box->window;
-  this->panel = new_panel(this->window);
+  this->surface = box->surface;
 
   auto cb = [self =
                  std::weak_ptr<UINode>{self_}](Event::MouseData data) -> void {
@@ -1112,12 +6339,16 @@ UINode::UINode(Event::MouseEvent* e, int x, int y, std::string label, F&& c0b) {
     }
   };
 
-  auto button = UIButton::create(e, "Exit", 8, 8, cb);
+  auto button = UIButton::create(e, "Exit", 8, 8, cb, res);
 
   composition.emplace_back(box);
   composition.emplace_back(text);
   composition.emplace_back(std::move(button));
 
+  // created last so the panel deck matches the render order
+  if (this->window)
+    this->panel = res.panel(this->window);
+
   // logToFile("Callback: "+std::to_string(std::forward(g_mouse_callback)));
 
   // [](Event::MouseData d) {
@@ -1150,7 +6381,7 @@ UINode::UINode(Event::MouseEvent* e, int x, int y, std::string label, F&& c0b) {
     //   composition.pop_back();
     //   current_line.reset();
     // }
-  });
+  }, lifetime());
 
   e->add(Event::Type::Mouseup, [&](Event::MouseData d) {
     // if (current_line && d.element && d.element->type() == Type::Id::Node &&
@@ -1162,22 +6393,17 @@ UINode::UINode(Event::MouseEvent* e, int x, int y, std::string label, F&& c0b) {
     //   current_line.reset();
     //   line_origin = {0, 0};
     // }
-  });
+  }, lifetime());
 
   e->add(Event::Type::Mousemove, [&](Event::MouseData d) {
-    if (d.selected_element && d.selected_element->window == this->window) {
-      this->x = d.x - d.offset_x;
-      this->y = d.y - d.offset_y;
-      // auto box =
-      //     std::static_pointer_cast<UIBox>(this->clickable->composition.front());
-      // box->set_pos(this->x, this->y);
-      mvwin(this->window, this->y, this->x);
+    if (d.selected_element && d.selected_element->shares_window(this)) {
+      set_pos(d.x - d.offset_x, d.y - d.offset_y);
     }
 
     // if (!d.selected_element && current_line) {
     //   current_line->set_pos(line_origin, Coords{d.x, d.y});
     // }
-  });
+  }, lifetime());
 }
 
 template <typename F>
@@ -1185,8 +6411,9 @@ std::shared_ptr<UINode> UINode::create(Event::MouseEvent* e,
                                        int x,
                                        int y,
                                        std::string label,
-                                       F&& callback) {
-  return std::make_shared<UINode>(e, x, y, label, callback);
+                                       F&& callback,
+                                       const ElementResources& res) {
+  return res.make<UINode>(e, x, y, label, callback);
 }
 
 #endif
@@ -9,8 +9,8 @@ int main() {
   UIContext* ctx = new UIContext();
 
   auto g_mouse_callback = [](Event::MouseData d) { d.ctx->stop(); };
-  auto button = UIButton::create(&ctx->mouse_event, "Quit",
-                                 ctx->get_width() - 6, 0, g_mouse_callback);
+  auto button = ctx->resources().make<UIButton>(
+      &ctx->mouse_event, "Quit", ctx->get_width() - 6, 0, g_mouse_callback);
 
   ctx->screen_event.add(Event::Type::Resize, [&](Event::ScreenData d) {
     auto p = button->composition[1];
@@ -42,8 +42,8 @@ int main() {
 
   for (int x{}; x < 1; x++) {
     std::string str{"node" + std::to_string(x)};
-    auto node =
-        UINode::create(&ctx->mouse_event, 0, x * 4, str, g_mouse_callback);
+    auto node = ctx->resources().make<UINode>(&ctx->mouse_event, 0, x * 4,
+                                              str, g_mouse_callback);
     // auto button =
     //     UIButton::create(&ctx->mouse_event, "eXit", 8, 8, g_mouse_callback);
     // node->callback = g_mouse_callback;
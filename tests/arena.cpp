@@ -0,0 +1,91 @@
+#include <cstdlib>
+#include <new>
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+static size_t allocations{};
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+static auto noop = [](Event::MouseData) {};
+
+// clearing the scene releases the arena even though the context's events
+// still hold handlers of the destroyed elements
+static void release_on_clear(UIContext& ctx) {
+  ElementArena& arena = ctx.arena();
+  const ElementResources& res = ctx.resources();
+  {
+    std::vector<std::shared_ptr<UINode>> nodes;
+    for (int i{}; i < 32; i++) {
+      nodes.emplace_back(
+          res.make<UINode>(&ctx.mouse_event, i * 2, i, "node", noop));
+      ctx.add_child(nodes.back());
+    }
+    for (int i{1}; i < 32; i++) {
+      nodes[i - 1]->connect(nodes[i].get());
+    }
+    ctx.add_child(res.make<UIButton>(&ctx.mouse_event, "Quit", 0, 0, noop));
+    EXPECT(arena.live() >= 33);
+    EXPECT(ctx.mouse_event.size() > 0);
+  }
+  ctx.clear_children();
+  EXPECT(arena.live() == 0);
+  EXPECT(arena.bytes() == 0);
+  // peak_bytes() only resets on release
+  EXPECT(arena.peak_bytes() == 0);
+}
+
+// elements may outlive the clear, the arena is released once they are gone
+static void release_after_outliving(UIContext& ctx) {
+  ElementArena& arena = ctx.arena();
+  auto box = ctx.resources().make<UIBox>(4, 4, 6, 3);
+  ctx.add_child(box);
+  ctx.clear_children();
+  EXPECT(arena.live() > 0);
+  EXPECT(!arena.release());
+  box.reset();
+  EXPECT(arena.release());
+}
+
+// nodes take their sub-elements, compositions, lifetime tokens and
+// callbacks from the arena, only the shared handler table grows on the heap
+static void node_allocations(UIContext& ctx) {
+  constexpr int count = 64;
+  std::vector<std::shared_ptr<UINode>> nodes;
+  nodes.reserve(count);
+  size_t live = ctx.arena().live();
+  allocations = 0;
+  for (int i{}; i < count; i++) {
+    nodes.emplace_back(
+        ctx.resources().make<UINode>(&ctx.mouse_event, i, i, "node", noop));
+  }
+  size_t global = allocations;
+  EXPECT(global * 4 < count);
+  // node, button, two boxes and texts, compositions, tokens and callback
+  EXPECT(ctx.arena().live() - live >= count * 10);
+  nodes.clear();
+  ctx.clear_children();
+  EXPECT(ctx.arena().live() == 0);
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  node_allocations(*ctx);
+  release_on_clear(*ctx);
+  release_after_outliving(*ctx);
+  ctx.reset();
+  return report("arena");
+}
@@ -0,0 +1,46 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+static bool blank(int x, int y) {
+  cchar_t cell;
+  mvwin_wch(stdscr, y, x, &cell);
+  return cell.chars[0] == L' ';
+}
+
+// bundles missing the wait of their render are shown once the worker is
+// done, without any input waking the event loop
+static void late_result(UIContext& ctx) {
+  ctx.set_edge_style(EdgeStyle::Bundled);
+  ctx.set_bundle_wait(std::chrono::microseconds(0));
+  EXPECT(ctx.idle_timeout() == -1);
+
+  // enough edges that the worker cannot be done within the render
+  std::vector<std::shared_ptr<UILine>> lines;
+  ctx.begin_update();
+  for (int i{}; i < 2000; i++) {
+    lines.emplace_back(UILine::create(Coords{4, 2}, Coords{60, 22}));
+    ctx.add_child(lines.back());
+  }
+  ctx.commit();
+  ctx.batch_render();
+  EXPECT(ctx.idle_timeout() >= 0);
+  EXPECT(blank(4, 2));
+
+  // what UIContext::start() does while wgetch() times out
+  for (int i{}; i < 500 && ctx.idle_timeout() >= 0; i++) {
+    napms(ctx.idle_timeout());
+    ctx.batch_render();
+  }
+  EXPECT(ctx.idle_timeout() == -1);
+  EXPECT(!blank(4, 2));
+
+  ctx.clear_children();
+  ctx.set_edge_style(EdgeStyle::Lines);
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  late_result(*ctx);
+  ctx.reset();
+  return report("bundle");
+}
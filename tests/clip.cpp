@@ -0,0 +1,64 @@
+#include <random>
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+// the AVX2 kernel and the scalar path give the same ranges
+static void kernel_matches_scalar() {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> x(-50, 130);
+  std::uniform_int_distribution<int> y(-20, 44);
+  SegmentClipper clipper;
+  for (int i{}; i < 10007; i++) {
+    clipper.add(Coords{x(rng), y(rng)}, Coords{x(rng), y(rng)});
+  }
+  // segments on the viewport edges and degenerate ones
+  clipper.add(Coords{0, 0}, Coords{79, 0});
+  clipper.add(Coords{79, -5}, Coords{79, 30});
+  clipper.add(Coords{5, 5}, Coords{5, 5});
+  clipper.add(Coords{-10, 3}, Coords{-10, 3});
+
+  clipper.clip(80, 24);
+  std::vector<std::pair<int, int>> kernel;
+  for (size_t i{}; i < clipper.size(); i++) {
+    kernel.emplace_back(clipper.first(i), clipper.last(i));
+  }
+  clipper.clip_scalar(80, 24);
+  size_t mismatches{};
+  for (size_t i{}; i < clipper.size(); i++) {
+    mismatches += kernel[i] != std::pair{clipper.first(i), clipper.last(i)};
+  }
+  EXPECT(mismatches == 0);
+}
+
+// every visible cell of a segment lies within its clipped range
+static void no_visible_cell_missed() {
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> x(-50, 130);
+  std::uniform_int_distribution<int> y(-20, 44);
+  SegmentClipper clipper;
+  std::vector<std::pair<Coords, Coords>> segments;
+  for (int i{}; i < 2000; i++) {
+    segments.emplace_back(Coords{x(rng), y(rng)}, Coords{x(rng), y(rng)});
+    clipper.add(segments.back().first, segments.back().second);
+  }
+  clipper.clip(80, 24);
+  size_t missed{};
+  for (size_t i{}; i < segments.size(); i++) {
+    int step{};
+    UILine::trace(segments[i].first, segments[i].second,
+                  [&](int cx, int cy, char) {
+                    bool visible = cx >= 0 && cx < 80 && cy >= 0 && cy < 24;
+                    if (visible &&
+                        (step < clipper.first(i) || step > clipper.last(i)))
+                      missed++;
+                    step++;
+                  });
+  }
+  EXPECT(missed == 0);
+}
+
+int main() {
+  kernel_matches_scalar();
+  no_visible_cell_missed();
+  return report("clip");
+}
@@ -0,0 +1,139 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+namespace {
+
+struct CountingBox : UIBox {
+  int* renders;
+  CountingBox(int* renders) : UIBox(6, 3, 2, 2), renders(renders) {}
+  void render() override { (*renders)++; }
+};
+
+struct CountingLine : UILine {
+  int* renders;
+  CountingLine(int* renders)
+      : UILine(Coords{0, 10}, Coords{20, 12}, nullptr), renders(renders) {}
+  void render() override { (*renders)++; }
+};
+
+const DrawCommand* command_of(UIContext& ctx, AbstractUIElement* element) {
+  for (const DrawCommand& cmd : ctx.display_list().commands()) {
+    if (cmd.element == element)
+      return &cmd;
+  }
+  return nullptr;
+}
+
+DrawCommand::Kind kind_of(UIContext& ctx, AbstractUIElement* element) {
+  const DrawCommand* cmd = command_of(ctx, element);
+  return cmd ? cmd->kind : DrawCommand::Kind::Element;
+}
+
+}  // namespace
+
+// built-in types are drawn statically, subclasses keep their render()
+static void subclass_fallback(UIContext& ctx) {
+  int box_renders{};
+  int line_renders{};
+  auto box = std::make_shared<CountingBox>(&box_renders);
+  auto line = std::make_shared<CountingLine>(&line_renders);
+  auto plain_box = UIBox::create(10, 2, 4, 3);
+  auto plain_line = UILine::create(Coords{0, 14}, Coords{20, 16});
+  ctx.add_child(box);
+  ctx.add_child(line);
+  ctx.add_child(plain_box);
+  ctx.add_child(plain_line);
+
+  EXPECT(kind_of(ctx, box.get()) == DrawCommand::Kind::Element);
+  EXPECT(kind_of(ctx, line.get()) == DrawCommand::Kind::Element);
+  EXPECT(kind_of(ctx, plain_box.get()) == DrawCommand::Kind::Box);
+  EXPECT(kind_of(ctx, plain_line.get()) == DrawCommand::Kind::Line);
+
+  ctx.batch_render();
+  EXPECT(box_renders == 1);
+  EXPECT(line_renders == 1);
+
+  // patching keeps the kind
+  line->set_pos(Coords{0, 11}, Coords{20, 13});
+  EXPECT(kind_of(ctx, line.get()) == DrawCommand::Kind::Element);
+  ctx.batch_render();
+  EXPECT(line_renders == 2);
+
+  ctx.clear_children();
+}
+
+// a label replaced during an update is drawn from the list's own copy
+static void relabel_in_update(UIContext& ctx) {
+  auto text = UIText::create(2, 2, "short");
+  ctx.add_child(text);
+  ctx.batch_render();
+
+  ctx.begin_update();
+  text->set_label(std::string(40, 'x'));
+  const DrawCommand* cmd = command_of(ctx, text.get());
+  EXPECT(cmd && cmd->text == text->get_label());
+  ctx.batch_render();
+  EXPECT((mvwinch(text->window, 1, 1) & A_CHARTEXT) == 'x');
+  ctx.commit();
+  ctx.clear_children();
+}
+
+// children added to or removed from an attached composition are drawn or
+// dropped without any call to the context
+static void composition_edits(UIContext& ctx) {
+  auto box = UIBox::create(2, 2, 10, 4);
+  ctx.add_child(box);
+  EXPECT(ctx.display_list().size() == 1);
+
+  auto line = UILine::create(Coords{1, 1}, Coords{6, 1}, box->window);
+  box->composition.emplace_back(line);
+  EXPECT(ctx.display_list().size() == 2);
+  EXPECT(kind_of(ctx, line.get()) == DrawCommand::Kind::Line);
+  EXPECT(ctx.store().alive(line->handle));
+
+  box->composition.clear();
+  EXPECT(ctx.display_list().size() == 1);
+  EXPECT(!line->scene);
+  ctx.clear_children();
+}
+
+// boxes and texts outside of the screen are culled through the store
+static void culling(UIContext& ctx) {
+  ctx.set_virtual_surfaces(true);
+  auto shown = ctx.resources().make<UIBox>(6, 3, 2, 2);
+  auto hidden = ctx.resources().make<UIBox>(6, 3, 2, 6);
+  ctx.set_virtual_surfaces(false);
+  EXPECT(shown->surface && hidden->surface);
+  ctx.add_child(shown);
+  ctx.add_child(hidden);
+  hidden->set_pos(-20, 6);
+
+  std::span<const uint8_t> visible = ctx.cull();
+  EXPECT(visible[shown->handle.index]);
+  EXPECT(!visible[hidden->handle.index]);
+  hidden->set_pos(ctx.get_width() - 3, ctx.get_height() - 1);
+  visible = ctx.cull();
+  EXPECT(visible[hidden->handle.index]);
+  ctx.clear_children();
+
+  // the renderer skips commands of culled slots
+  auto box = UIBox::create(2, 2, 6, 3);
+  ctx.add_child(box);
+  werase(box->window);
+  std::vector<uint8_t> none(ctx.store().capacity());
+  ctx.render(ctx.display_list(), &ctx.compositor(), none);
+  EXPECT((mvwinch(box->window, 0, 0) & A_CHARTEXT) == ' ');
+  ctx.render(ctx.display_list(), &ctx.compositor(), ctx.cull());
+  EXPECT((mvwinch(box->window, 0, 0) & A_CHARTEXT) != ' ');
+  ctx.clear_children();
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  subclass_fallback(*ctx);
+  relabel_in_update(*ctx);
+  composition_edits(*ctx);
+  culling(*ctx);
+  ctx.reset();
+  return report("display_list");
+}
@@ -0,0 +1,175 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+static auto noop = [](Event::MouseData) {};
+
+// curves are hit along their polyline and never over the boxes of the
+// nodes they connect
+static void curve_hit(UIContext& ctx) {
+  auto a = UINode::create(&ctx.mouse_event, 2, 2, "a", noop);
+  auto b = UINode::create(&ctx.mouse_event, 50, 16, "b", noop);
+  ctx.add_child(a);
+  ctx.add_child(b);
+  auto curve = a->connect_curve(b.get());
+
+  Coords anchor = a->get_anchor();
+  auto hit = ctx.hit_test(anchor.x, anchor.y);
+  EXPECT(hit.element && hit.element->type() == Type::Id::Box);
+  EXPECT(hit.root == a.get());
+
+  auto points = curve->get_points();
+  Coords mid = points[points.size() / 2];
+  hit = ctx.hit_test(mid.x, mid.y);
+  EXPECT(hit.element.get() == curve.get());
+  EXPECT(hit.root == nullptr);
+
+  // inside the bounding box of the curve, far from its polyline
+  Bounds bounds = curve->get_bounds();
+  Coords corner{bounds.x + bounds.width - 1, bounds.y};
+  EXPECT(ctx.hit_test(corner.x, corner.y).element == nullptr);
+  EXPECT(ctx.edge_at(corner.x, corner.y) == nullptr);
+
+  // moving a node moves the indexed polyline with it
+  b->set_pos(50, 4);
+  points = curve->get_points();
+  mid = points[points.size() / 2];
+  EXPECT(ctx.edge_at(mid.x, mid.y).get() == curve.get());
+
+  ctx.clear_children();
+}
+
+// lines erasing their footprint redraw the curves they crossed
+static void curve_damage(UIContext& ctx) {
+  auto a = UINode::create(&ctx.mouse_event, 2, 2, "a", noop);
+  auto b = UINode::create(&ctx.mouse_event, 50, 16, "b", noop);
+  ctx.add_child(a);
+  ctx.add_child(b);
+  auto curve = a->connect_curve(b.get());
+  auto points = curve->get_points();
+  Coords mid = points[points.size() / 2];
+
+  auto line = UILine::create(Coords{mid.x, 0}, Coords{mid.x, 20});
+  ctx.add_child(line);
+  curve->take_damage();
+  line->set_pos(Coords{70, 0}, Coords{70, 20});
+  EXPECT(curve->take_damage());
+
+  // and the same for curves moving off lines
+  line->take_damage();
+  line->set_pos(Coords{mid.x, 0}, Coords{mid.x, 20});
+  line->take_damage();
+  b->set_pos(60, 2);
+  EXPECT(line->take_damage());
+
+  ctx.clear_children();
+}
+
+// orthogonal styles hit edges along the elbow or route they are drawn as
+static void orthogonal_hit(UIContext& ctx) {
+  auto line = UILine::create(Coords{10, 2}, Coords{30, 12});
+  ctx.add_child(line);
+  ctx.set_edge_style(EdgeStyle::Orthogonal);
+  ctx.batch_render();
+
+  // the elbow turns at x = 20, far from the straight segment
+  EXPECT(ctx.edge_at(20, 10, 0).get() == line.get());
+  EXPECT(ctx.edge_at(12, 3, 0) == nullptr);
+  EXPECT(ctx.edge_at(28, 12, 0).get() == line.get());
+
+  // a box on the elbow makes the router go around it
+  auto box = UIBox::create(18, 4, 5, 5);
+  ctx.add_child(box);
+  ctx.set_edge_style(EdgeStyle::Routed);
+  ctx.batch_render();
+  EXPECT(ctx.edge_at(20, 6, 0) == nullptr);
+  bool routed{};
+  for (int y{}; y < 20; y++) {
+    routed |= ctx.edge_at(17, y, 0).get() == line.get() ||
+              ctx.edge_at(23, y, 0).get() == line.get();
+  }
+  EXPECT(routed);
+
+  // and back to straight segments
+  ctx.set_edge_style(EdgeStyle::Lines);
+  ctx.batch_render();
+  EXPECT(ctx.edge_at(20, 10, 0) == nullptr);
+  EXPECT(ctx.edge_at(20, 7, 0).get() == line.get());
+
+  ctx.clear_children();
+}
+
+// the obstacle map follows boxes added, moved and dropped, and only routes
+// under changed cells are routed again
+static void router_obstacles() {
+  EdgeRouter router;
+  int edge_key{}, box_key{};
+  EdgeRouter::Edge edge{.key = &edge_key, .pos1 = {2, 7}, .pos2 = {37, 7}};
+  auto map = [&](Bounds box) {
+    router.begin_obstacles(40, 20);
+    if (box.width > 0)
+      router.add_obstacle(&box_key, box);
+    bool changed = router.end_obstacles();
+    router.update({&edge, 1});
+    return changed;
+  };
+
+  EXPECT(map(Bounds{15, 4, 6, 6}));
+  EXPECT(router.path(&edge_key).size() > 2);
+  EXPECT(!map(Bounds{15, 4, 6, 6}));
+  EXPECT(router.routed() == 0);
+
+  // moving the box off the route frees the cells it blocked
+  EXPECT(map(Bounds{15, 12, 6, 6}));
+  EXPECT(router.routed() == 1);
+  EXPECT(router.path(&edge_key).size() == 2);
+
+  // changes away from the route keep it
+  EXPECT(map(Bounds{15, 13, 6, 6}));
+  EXPECT(router.routed() == 0);
+  EXPECT(map(Bounds{}));
+  EXPECT(router.routed() == 0);
+}
+
+// connecting nodes joined by a curve with a line replaces the curve
+static void line_replaces_curve(UIContext& ctx) {
+  auto a = UINode::create(&ctx.mouse_event, 2, 2, "a", noop);
+  auto b = UINode::create(&ctx.mouse_event, 40, 12, "b", noop);
+  ctx.add_child(a);
+  ctx.add_child(b);
+  auto curve = a->connect_curve(b.get());
+  auto line = b->connect(a.get());
+  EXPECT(line);
+  EXPECT(a->degree() == 1 && b->degree() == 1);
+  EXPECT(!curve->scene);
+  EXPECT(line->scene);
+  EXPECT(a->connect(b.get()) == line);
+  ctx.clear_children();
+}
+
+// and connecting nodes joined by a line with a curve replaces the line
+static void curve_replaces_line(UIContext& ctx) {
+  auto a = UINode::create(&ctx.mouse_event, 2, 2, "a", noop);
+  auto b = UINode::create(&ctx.mouse_event, 40, 12, "b", noop);
+  ctx.add_child(a);
+  ctx.add_child(b);
+  auto line = a->connect(b.get());
+  auto curve = b->connect_curve(a.get());
+  EXPECT(curve);
+  EXPECT(a->degree() == 1 && b->degree() == 1);
+  EXPECT(!line->scene);
+  EXPECT(curve->scene);
+  EXPECT(a->connect_curve(b.get()) == curve);
+  ctx.clear_children();
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  curve_hit(*ctx);
+  curve_damage(*ctx);
+  orthogonal_hit(*ctx);
+  line_replaces_curve(*ctx);
+  curve_replaces_line(*ctx);
+  router_obstacles();
+  ctx.reset();
+  return report("edge_hit");
+}
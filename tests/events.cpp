@@ -0,0 +1,99 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+namespace {
+
+struct Probe : AbstractUIElement {
+  int* destroyed;
+  explicit Probe(int* destroyed) : destroyed(destroyed) {}
+  ~Probe() override { (*destroyed)++; }
+  void render() override {}
+  Type::Id type() override { return Type::Id::None; }
+};
+
+struct Data {
+  int value{};
+};
+
+}  // namespace
+
+// handlers adding handlers must not invalidate the running dispatch
+static void add_during_dispatch() {
+  Event::GenericEvent<Data> event;
+  int calls{};
+  int added{};
+  auto adder = [&](Data) {
+    calls++;
+    for (int i{}; i < 64; i++) {
+      event.add(Event::Type::Click, [&](Data) { added++; });
+    }
+  };
+  event.add(Event::Type::Click, adder);
+  event.update(Event::Type::Click);
+  EXPECT(calls == 1);
+  EXPECT(added == 0);
+  EXPECT(event.size() == 65);
+
+  event.update(Event::Type::Click);
+  EXPECT(calls == 2);
+  EXPECT(added == 64);
+}
+
+// removal during dispatch is deferred, the remaining handlers still run
+static void remove_during_dispatch() {
+  Event::GenericEvent<Data> event;
+  int second{};
+  auto first = [&](Data) {};
+  auto remover = [&](Data) { event.remove(first); };
+  event.add(Event::Type::Click, remover);
+  event.add(Event::Type::Click, first);
+  event.add(Event::Type::Click, [&](Data) { second++; });
+  event.update(Event::Type::Click);
+  EXPECT(second == 1);
+  EXPECT(event.size() == 2);
+}
+
+// an element destroying itself from its handler lives until it returns
+static void owner_kept_alive() {
+  Event::GenericEvent<Data> event;
+  int destroyed{};
+  bool alive_in_handler{};
+  auto probe = std::make_shared<Probe>(&destroyed);
+  event.add(
+      Event::Type::Click,
+      [&, p = probe.get()](Data) {
+        probe.reset();
+        alive_in_handler = destroyed == 0 && p->destroyed == &destroyed;
+      },
+      probe->lifetime());
+  event.update(Event::Type::Click);
+  EXPECT(alive_in_handler);
+  EXPECT(destroyed == 1);
+
+  // and its handler is dropped once it is gone
+  event.update(Event::Type::Click);
+  EXPECT(event.size() == 0);
+}
+
+// handlers bound in constructors run before shared ownership exists
+static void unowned_element() {
+  Event::GenericEvent<Data> event;
+  int destroyed{};
+  int calls{};
+  {
+    Probe probe(&destroyed);
+    event.add(Event::Type::Click, [&](Data) { calls++; }, probe.lifetime());
+    event.update(Event::Type::Click);
+  }
+  event.update(Event::Type::Click);
+  EXPECT(calls == 1);
+  EXPECT(event.size() == 0);
+}
+
+int main() {
+  add_during_dispatch();
+  remove_during_dispatch();
+  owner_kept_alive();
+  unowned_element();
+  return report("events");
+}
@@ -0,0 +1,43 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+// lines given the screen explicitly must not shrink it to their extent
+static void explicit_stdscr(UIContext& ctx) {
+  int width = getmaxx(stdscr);
+  int height = getmaxy(stdscr);
+  auto line = UILine::create(Coords{1, 1}, Coords{4, 2}, stdscr);
+  EXPECT(line->window == stdscr);
+  EXPECT(getmaxx(stdscr) == width);
+  EXPECT(getmaxy(stdscr) == height);
+  EXPECT(ctx.get_width() == width);
+}
+
+// Braille lines set the dots UILine::trace() visits, pos2 included
+static void braille_line() {
+  WINDOW* window = newwin(2, 4, 0, 0);
+  BrailleCanvas canvas;
+  canvas.resize(4, 2);
+  canvas.line(Coords{0, 0}, Coords{3, 3});
+  canvas.line(Coords{0, 5}, Coords{7, 5});
+  EXPECT(canvas.flush(window) == 6);
+
+  auto mask = [window](int x, int y) {
+    cchar_t cell;
+    mvwin_wch(window, y, x, &cell);
+    return static_cast<int>(cell.chars[0]) - 0x2800;
+  };
+  EXPECT(mask(0, 0) == 0x11);
+  EXPECT(mask(1, 0) == 0x84);
+  for (int x{}; x < 4; x++) {
+    EXPECT(mask(x, 1) == 0x12);
+  }
+  delwin(window);
+}
+
+int main() {
+  auto ctx = std::make_unique<UIContext>();
+  explicit_stdscr(*ctx);
+  braille_line();
+  ctx.reset();
+  return report("line");
+}
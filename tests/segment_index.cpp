@@ -0,0 +1,63 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+// owners are only used as keys, they are never dereferenced
+static int tokens[4];
+static AbstractUIElement* owner(int i) {
+  return reinterpret_cast<AbstractUIElement*>(&tokens[i]);
+}
+
+static void steep_segment() {
+  SegmentIndex index;
+  index.update(owner(0), {7, 0}, {8, 100});
+
+  // every row of a segment crossing a bucket column edge is reachable
+  for (int y{}; y <= 100; y++) {
+    EXPECT(index.query(7, y, 1) == owner(0));
+  }
+  EXPECT(index.query(7, 50, 1) == owner(0));
+  EXPECT(index.query(8, 50, 1) == owner(0));
+  EXPECT(index.query(20, 50, 1) == nullptr);
+
+  // the same segment traversed right to left
+  index.update(owner(0), {8, 100}, {7, 0});
+  EXPECT(index.query(7, 50, 1) == owner(0));
+  EXPECT(index.query(8, 50, 1) == owner(0));
+}
+
+static void steep_negative_segment() {
+  SegmentIndex index;
+  index.update(owner(1), {-9, 60}, {-6, -60});
+  for (int y{-60}; y <= 60; y += 5) {
+    int x = -9 + (60 - y) * 3 / 120;
+    EXPECT(index.query(x, y, 1) == owner(1));
+  }
+}
+
+static void vertical_segment() {
+  SegmentIndex index;
+  index.update(owner(2), {3, 0}, {3, 40});
+  EXPECT(index.query(3, 20, 0) == owner(2));
+  index.remove(owner(2));
+  EXPECT(index.query(3, 20, 0) == nullptr);
+  EXPECT(index.size() == 0);
+}
+
+static void near_steep_segment() {
+  SegmentIndex index;
+  index.update(owner(0), {7, 0}, {8, 100});
+  index.update(owner(3), {0, 50}, {15, 50});
+  bool found{};
+  index.for_each_near(owner(3), [&](AbstractUIElement* e) {
+    found |= e == owner(0);
+  });
+  EXPECT(found);
+}
+
+int main() {
+  steep_segment();
+  steep_negative_segment();
+  vertical_segment();
+  near_steep_segment();
+  return report("segment_index");
+}
@@ -0,0 +1,119 @@
+#include "../src/include/hawktui.hpp"
+#include "test.hpp"
+
+static SceneRecord record(int x) {
+  SceneRecord r{};
+  r.bounds.x = x;
+  return r;
+}
+
+// published chunks are copied before writing, even when nothing else seems
+// to hold them
+static void published_kept() {
+  SnapshotWriter writer;
+  writer.write(0, record(1));
+  writer.write(64, record(1));
+  SceneSnapshot first = writer.snapshot(1);
+  writer.write(0, record(2));
+  EXPECT(first.at(0)->bounds.x == 1);
+
+  SceneSnapshot second = writer.snapshot(2);
+  EXPECT(second.at(0)->bounds.x == 2);
+  EXPECT(first.shared_chunks(second) == 1);
+
+  // written once per snapshot, copied once per snapshot
+  writer.write(1, record(3));
+  writer.write(2, record(3));
+  EXPECT(second.at(1) == nullptr);
+  SceneSnapshot third = writer.snapshot(3);
+  EXPECT(third.at(1)->bounds.x == 3 && third.at(2)->bounds.x == 3);
+  EXPECT(second.shared_chunks(third) == 1);
+}
+
+// a write copies its page and chunk, untouched pages stay shared whole
+static void pages_shared() {
+  constexpr uint32_t page_slots =
+      SceneSnapshot::chunk_size * SceneSnapshot::page_size;
+  SnapshotWriter writer;
+  for (uint32_t i{}; i < page_slots * 2; i++) {
+    writer.write(i, record(1));
+  }
+  SceneSnapshot first = writer.snapshot(1);
+  writer.write(page_slots + 3, record(2));
+  SceneSnapshot second = writer.snapshot(2);
+
+  size_t chunks = SceneSnapshot::page_size * 2;
+  EXPECT(first.shared_chunks(second) == chunks - 1);
+  std::vector<uint32_t> changed;
+  second.for_each_changed(first, [&](uint32_t i) { changed.push_back(i); });
+  EXPECT(changed.size() == SceneSnapshot::chunk_size);
+  EXPECT(changed.front() == page_slots);
+  EXPECT(first.at(page_slots + 3)->bounds.x == 1);
+  EXPECT(second.at(page_slots + 3)->bounds.x == 2);
+}
+
+// a reader on another thread sees every snapshot as it was published
+static void concurrent_reader() {
+  constexpr uint32_t slots = 256;
+  SnapshotWriter writer;
+  std::mutex mutex;
+  SceneSnapshot latest = writer.snapshot(0);
+  std::atomic<bool> done{false};
+  int torn{};
+
+  std::thread reader([&]() {
+    while (!done) {
+      SceneSnapshot snapshot;
+      {
+        std::lock_guard lock(mutex);
+        snapshot = latest;
+      }
+      for (uint32_t i{}; i < snapshot.capacity(); i++) {
+        const SceneRecord* r = snapshot.at(i);
+        torn += !r || r->bounds.x != static_cast<int>(snapshot.version());
+      }
+    }
+  });
+  for (int version = 1; version <= 500; version++) {
+    for (uint32_t i{}; i < slots; i++) {
+      writer.write(i, record(version));
+    }
+    SceneSnapshot snapshot = writer.snapshot(version);
+    std::lock_guard lock(mutex);
+    latest = std::move(snapshot);
+  }
+  done = true;
+  reader.join();
+  EXPECT(torn == 0);
+}
+
+// a frame built on a worker while the scene changes draws the snapshot
+static void frame_off_thread(UIContext& ctx) {
+  ctx.set_snapshots(true);
+  auto box = UIBox::create(2, 2, 6, 3);
+  ctx.add_child(box);
+  SceneSnapshot snapshot = ctx.snapshot();
+
+  SnapshotFrame frame;
+  std::thread worker([&]() { frame = SnapshotFrame(snapshot); });
+  box->set_pos(20, 10);
+  worker.join();
+
+  werase(stdscr);
+  ctx.render(frame, stdscr);
+  EXPECT(frame.records().size() == 1);
+  EXPECT((mvwinch(stdscr, 2, 2) & A_CHARTEXT) != ' ');
+  EXPECT((mvwinch(stdscr, 10, 20) & A_CHARTEXT) == ' ');
+  ctx.clear_children();
+  ctx.set_snapshots(false);
+}
+
+int main() {
+  published_kept();
+  pages_shared();
+  concurrent_reader();
+  auto ctx = std::make_unique<UIContext>();
+  frame_off_thread(*ctx);
+  ctx.reset();
+  return report("snapshot");
+}
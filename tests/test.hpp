@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdio>
+
+/** @brief Number of failed expectations in the current test program. */
+inline int failures{};
+
+/** @brief Records a failure and keeps going if a condition does not hold. */
+#define EXPECT(cond)                                                   \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                      \
+    }                                                                  \
+  } while (0)
+
+/** @brief Reports the result of a test program, use as its exit code. */
+inline int report(const char* name) {
+  if (failures)
+    std::fprintf(stderr, "%s: %d failure(s)\n", name, failures);
+  return failures ? 1 : 0;
+}